@@ -75,6 +75,10 @@ public:
 
     /// Read a line from the file
     std::string readline();
+    /// Read a line from the file into `line`, reusing its allocation. This
+    /// is useful when reading lines in a loop, where a single buffer can
+    /// serve for the whole loop.
+    void readline(std::string& line);
     /// Read `n` lines from the file
     std::vector<std::string> readlines(size_t n);
 
@@ -93,8 +97,12 @@ protected:
     TextFile(std::string path, File::Mode mode, File::Compression compression, std::streambuf* buffer);
 
 private:
-    void get_line_impl(std::string& string);
-    void skip_line_impl();
+    /// Extract the next line of the stream into `string`. This is virtual so
+    /// that implementations with direct access to the underlying buffer can
+    /// locate the end of line in bulk instead of reading character by
+    /// character.
+    virtual void get_line_impl(std::string& string);
+    virtual void skip_line_impl();
 };
 
 } // namespace chemfiles
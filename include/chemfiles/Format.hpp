@@ -8,10 +8,13 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <utility>
+#include <cstdint>
 
 #include "chemfiles/File.hpp"
 #include "chemfiles/exports.h"
 #include "chemfiles/Error.hpp"
+#include "chemfiles/external/optional.hpp"
 
 namespace chemfiles {
 class Frame;
@@ -148,6 +151,68 @@ FormatInfo format_information() {
     throw FormatError("format_informations is unimplemented for this format");
 }
 
+/// Position of a single step in a text file, together with the number of
+/// atoms in this step when the format parsed it while scanning the file.
+struct StepPosition {
+    // NOLINT: formats that do not know the atom count rely on the implicit
+    // conversion from a bare position
+    StepPosition(std::streampos position_): position(position_) {}
+    StepPosition(std::streampos position_, size_t natoms_):
+        position(position_), natoms(natoms_) {}
+
+    /// Position of the step start in the file
+    std::streampos position;
+    /// Number of atoms in the step, if it was parsed while scanning
+    optional<size_t> natoms = nullopt;
+};
+
+/// Compact storage for the positions of all the steps in a file.
+///
+/// Successive steps in the same file have similar sizes, so the positions
+/// are stored as 32-bit deltas from the previous step instead of one full
+/// `StepPosition` per step. This cuts the index memory footprint by
+/// several times for trajectories with millions of steps. Deltas that do
+/// not fit in 32 bits go to a small overflow list. Accesses walk a cached
+/// cursor from the last accessed index, which is O(1) for the sequential
+/// access patterns of scanning and reading.
+class StepPositions {
+public:
+    /// Get the number of stored steps
+    size_t size() const { return count_; }
+    /// Check whether the list is empty
+    bool empty() const { return count_ == 0; }
+    /// Reserve memory for `count` steps
+    void reserve(size_t count);
+    /// Add a step at the end of the list. Steps must be added in file order.
+    void push_back(StepPosition step);
+    /// Get the step at `index`
+    StepPosition operator[](size_t index) const;
+
+private:
+    /// Get the distance between the steps at `index` and `index + 1`
+    uint64_t delta(size_t index) const;
+
+    /// Position of the first step
+    uint64_t base_ = 0;
+    /// Position of the last step
+    uint64_t back_ = 0;
+    /// Number of stored steps
+    size_t count_ = 0;
+    /// `deltas_[i]` is the distance between the steps at `i` and `i + 1`,
+    /// or `UINT32_MAX` if the distance is stored in `overflow_`
+    std::vector<uint32_t> deltas_;
+    /// (index, distance) pairs for deltas bigger than 32 bits, sorted by
+    /// index. This is empty for all but pathological files.
+    std::vector<std::pair<size_t, uint64_t>> overflow_;
+    /// Number of atoms for each step, with `UINT64_MAX` marking unknown
+    /// counts. Empty when no step has a known atom count.
+    std::vector<uint64_t> natoms_;
+
+    /// Index and position of the last accessed step
+    mutable size_t cursor_index_ = 0;
+    mutable uint64_t cursor_position_ = 0;
+};
+
 /// The `TextFormat` class defines a common, simpler interface for text based
 /// formats.
 ///
@@ -165,8 +230,23 @@ public:
     size_t nsteps() override;
 
     /// Fast-forward the file for one step, returning a valid position if the
-    /// file does contain one more step or `std::streampos(-1)` if it does not.
-    virtual std::streampos forward() = 0;
+    /// file does contain one more step or `std::streampos(-1)` if it does
+    /// not. Formats that parse the number of atoms while skipping a step
+    /// should store it in the returned `StepPosition`, so that later calls to
+    /// `read_step` do not need to parse it again.
+    virtual StepPosition forward() = 0;
+
+    /// Can `scan_all` split the file in chunks scanned in parallel? Formats
+    /// returning `true` here must also implement `can_split_at`.
+    virtual bool can_parallelize_scan() const { return false; }
+
+    /// Check whether a new step starts at `data`, which points to the
+    /// beginning of a line in the file, with `length` bytes left until the
+    /// end of the file.
+    ///
+    /// This function is called concurrently from multiple threads, and must
+    /// only use the given bytes, not the state of the format or the file.
+    virtual bool can_split_at(const char* data, size_t length) const;
 
     virtual void read_next(Frame& frame);
     virtual void write_next(const Frame& frame);
@@ -175,13 +255,28 @@ protected:
     /// Text file where we read/write to
     std::unique_ptr<TextFile> file_;
 
+    /// Number of atoms in the step that is about to be read by `read_next`,
+    /// when it is known from a previous scan of the file. Formats can use it
+    /// to skip parsing the atom count again.
+    optional<size_t> natoms_hint_ = nullopt;
+
 private:
     /// Scan the whole file to get all the steps positions
     void scan_all();
 
+    /// Scan the `size` bytes of memory-mapped file content at `data` with
+    /// multiple threads, using `can_split_at` to recognize step boundaries,
+    /// and fill `steps_positions_` with the sorted results.
+    void parallel_scan(const char* data, size_t size);
+
     /// Storing the positions of all the steps in the file, so that we can
     /// just `seekg` them instead of reading the whole step.
-    std::vector<std::streampos> steps_positions_;
+    StepPositions steps_positions_;
+
+    /// Index of the step the file cursor is currently at. This is used to
+    /// reuse data cached in `steps_positions_` when reading sequentially
+    /// after a scan, and to only index steps that are not already known.
+    size_t current_step_ = 0;
 
     /// Did we found the end of file while scanning or reading?
     bool eof_found_ = false;
@@ -187,6 +187,15 @@ public:
     /// @example{frame/reserve.cpp}
     void reserve(size_t size);
 
+    /// Remove all the atoms in the frame, and allocate memory for `size`
+    /// atoms.
+    ///
+    /// This is equivalent to `resize(0)` followed by `reserve(size)`, and is
+    /// used when reading a frame with a known number of atoms.
+    ///
+    /// @example{frame/reserve_atoms.cpp}
+    void reserve_atoms(size_t size);
+
     /// Add an `atom` at the given `position` and optionally with the given
     /// `velocity`. The `velocity` value will only be used if this frame
     /// contains velocity data.
@@ -0,0 +1,83 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#ifndef CHEMFILES_MEMORY_MAPPED_FILES_HPP
+#define CHEMFILES_MEMORY_MAPPED_FILES_HPP
+
+#include <streambuf>
+#include <string>
+#include "chemfiles/File.hpp"
+
+namespace chemfiles {
+
+/// A `streambuf` whose whole get area is a read-only, memory-mapped view of a
+/// file. All read and seek operations are pointer arithmetic inside the
+/// mapping, without any system call or copy to an intermediate buffer.
+class memory_mapped_buffer final: public std::streambuf {
+public:
+    /// Map the file at `path` in memory. The file must be an existing,
+    /// regular file with a non-zero size.
+    memory_mapped_buffer(const std::string& path);
+    ~memory_mapped_buffer() override;
+
+    memory_mapped_buffer(const memory_mapped_buffer&) = delete;
+    memory_mapped_buffer& operator=(const memory_mapped_buffer&) = delete;
+    memory_mapped_buffer(memory_mapped_buffer&&) = delete;
+    memory_mapped_buffer& operator=(memory_mapped_buffer&&) = delete;
+
+    /// Get a pointer to the start of the file mapping
+    const char* data() const { return data_; }
+    /// Get the size of the file mapping
+    size_t size() const { return size_; }
+
+    /// Append the characters of the next line (without its end of line
+    /// marker) to `line`, and move the get area past the marker. The whole
+    /// line is located with `memchr` and appended in one piece, instead of
+    /// being extracted character by character through `sbumpc`. Returns
+    /// `false` if the get area is empty, i.e. at the end of the file.
+    bool getline(std::string& line);
+    /// Move the get area past the next end of line marker. Returns `false`
+    /// if no marker was left in the get area.
+    bool skipline();
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override;
+
+private:
+    /// Find the first end of line marker (`\n` or `\r`) in `[current, end)`,
+    /// or `nullptr` if there is none
+    static char* end_of_line(char* current, char* end);
+
+    /// Start of the file mapping
+    char* data_ = nullptr;
+    /// Size of the file mapping
+    size_t size_ = 0;
+};
+
+/// Read-only TextFile implementation using a memory-mapped view of the file
+/// instead of buffered read system calls. Scanning a file line-by-line with
+/// this class is limited by memory bandwidth, not by syscall count.
+class MemoryMappedFile final: public TextFile {
+public:
+    /// Map the text file at `path` in memory. The file must exist, be a
+    /// regular file, and have a non-zero size; and the platform must support
+    /// memory mapping; this constructor throws a `FileError` otherwise.
+    MemoryMappedFile(std::string path);
+
+    /// Get a pointer to the start of the file mapping
+    const char* data() const { return buffer_.data(); }
+    /// Get the size of the file mapping
+    size_t size() const { return buffer_.size(); }
+
+private:
+    void get_line_impl(std::string& line) override;
+    void skip_line_impl() override;
+
+    memory_mapped_buffer buffer_;
+};
+
+} // namespace chemfiles
+
+#endif
@@ -6,6 +6,7 @@
 
 #include <fstream>
 #include <string>
+#include <vector>
 #include "chemfiles/File.hpp"
 
 namespace chemfiles {
@@ -18,6 +19,11 @@ public:
     PlainFile(std::string path, File::Mode mode);
 
 private:
+    /// Userspace buffer for the filebuf, much larger than the default one
+    /// to reduce the number of read/write syscalls. Declared before
+    /// `buffer_` so that it outlives the final flush in the filebuf
+    /// destructor.
+    std::vector<char> stream_buffer_;
     std::filebuf buffer_;
 };
 
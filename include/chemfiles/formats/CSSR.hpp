@@ -23,7 +23,7 @@ public:
 
     void read_next(Frame& frame) override;
     void write_next(const Frame& frame) override;
-    std::streampos forward() override;
+    StepPosition forward() override;
 };
 
 template<> FormatInfo format_information<CSSRFormat>();
@@ -4,8 +4,9 @@
 #ifndef CHEMFILES_FORMAT_GRO_HPP
 #define CHEMFILES_FORMAT_GRO_HPP
 
-#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 #include <iosfwd>
 
 #include "chemfiles/Format.hpp"
@@ -25,11 +26,16 @@ public:
 
     void read_next(Frame& frame) override;
     void write_next(const Frame& frame) override;
-    std::streampos forward() override;
+    StepPosition forward() override;
+    bool can_parallelize_scan() const override { return true; }
+    bool can_split_at(const char* data, size_t length) const override;
 
 private:
-    /// Map of residues, indexed by residue id.
-    std::map<size_t, Residue> residues_;
+    /// List of residues, sorted by residue id. Atoms of a residue follow
+    /// each other in GRO files, so nearly all lookups only touch the last
+    /// entry, and a sorted vector is both smaller and faster than a tree or
+    /// a hash map here.
+    std::vector<std::pair<size_t, Residue>> residues_;
 };
 
 template<> FormatInfo format_information<GROFormat>();
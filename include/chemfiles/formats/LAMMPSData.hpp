@@ -5,12 +5,14 @@
 #define CHEMFILES_FORMAT_LAMMPS_DATA_HPP
 
 #include <tuple>
-#include <limits>
+#include <utility>
 #include <iosfwd>
 #include <vector>
 #include <string>
 #include <unordered_map>
 
+#include <fmt/format.h>
+
 #include "chemfiles/File.hpp"
 #include "chemfiles/Format.hpp"
 #include "chemfiles/Topology.hpp"  // IWYU pragma: keep
@@ -24,11 +26,15 @@ struct atom_data final {
     double x = 0;
     double y = 0;
     double z = 0;
-    double charge = std::numeric_limits<double>::quiet_NaN();
-    double mass = std::numeric_limits<double>::quiet_NaN();
+    double charge = 0;
+    double mass = 0;
     size_t index = 0;
     size_t type = 0;
     size_t molid = 0;
+    /// Did the atom style contain a charge for this atom?
+    bool has_charge = false;
+    /// Did the atom style contain a mass for this atom?
+    bool has_mass = false;
 };
 
 /// Possible LAMMPS atom style
@@ -60,6 +66,14 @@ using angle_type = std::tuple<size_t, size_t, size_t>;
 using dihedral_type = std::tuple<size_t, size_t, size_t, size_t>;
 using improper_type = std::tuple<size_t, size_t, size_t, size_t>;
 
+/// Hasher for the types above, combining the hashes of all the members
+struct type_hasher {
+    size_t operator()(const atom_type& type) const;
+    size_t operator()(const bond_type& type) const;
+    size_t operator()(const angle_type& type) const;
+    size_t operator()(const dihedral_type& type) const;
+};
+
 class DataTypes {
 public:
     DataTypes(const Topology& topology = Topology());
@@ -77,6 +91,11 @@ public:
     /// the vector backing the `sorted_set<atom_type>` returned by `atoms()`.
     size_t atom_type_id(const Atom& atom) const;
 
+    /// Get the atom type number of every atom in the topology used to
+    /// construct this `DataTypes` instance, indexed by atom index. This is
+    /// the result of `atom_type_id` resolved once per atom.
+    const std::vector<size_t>& atom_type_ids() const {return atom_type_ids_;}
+
     /// Get the bond type number for the bond type i-j.
     ///
     /// The bond type must be in the topology used to construct this `DataTypes`
@@ -113,6 +132,15 @@ private:
     sorted_set<angle_type> angles_;
     sorted_set<dihedral_type> dihedrals_;
     sorted_set<improper_type> impropers_;
+    std::vector<size_t> atom_type_ids_;
+
+    // Companion hash maps from type to position in the sorted sets above,
+    // giving O(1) `*_type_id` lookups in the writing hot loops
+    std::unordered_map<atom_type, size_t, type_hasher> atoms_index_;
+    std::unordered_map<bond_type, size_t, type_hasher> bonds_index_;
+    std::unordered_map<angle_type, size_t, type_hasher> angles_index_;
+    std::unordered_map<dihedral_type, size_t, type_hasher> dihedrals_index_;
+    std::unordered_map<improper_type, size_t, type_hasher> impropers_index_;
 };
 
 /// [LAMMPS Data] file format reader and writer.
@@ -137,7 +165,7 @@ public:
 
     void read_next(Frame& frame) override;
     void write_next(const Frame& frame) override;
-    std::streampos forward() override;
+    StepPosition forward() override;
 
 private:
     enum section_t {
@@ -179,23 +207,23 @@ private:
     void setup_names(Frame& frame) const;
 
     /// Write the header
-    void write_header(const DataTypes& types, const Frame& frame);
+    void write_header(fmt::memory_buffer& buffer, const DataTypes& types, const Frame& frame);
     /// Write the types sections
-    void write_types(const DataTypes& types);
+    void write_types(fmt::memory_buffer& buffer, const DataTypes& types);
     /// Write the masses section
-    void write_masses(const DataTypes& types);
+    void write_masses(fmt::memory_buffer& buffer, const DataTypes& types);
     /// Write the Atoms section
-    void write_atoms(const DataTypes& types, const Frame& frame);
+    void write_atoms(fmt::memory_buffer& buffer, const DataTypes& types, const Frame& frame);
     /// Write the Velocities section
-    void write_velocities(const Frame& frame);
+    void write_velocities(fmt::memory_buffer& buffer, const Frame& frame);
     /// Write the Bonds section
-    void write_bonds(const DataTypes& types, const Topology& topology);
+    void write_bonds(fmt::memory_buffer& buffer, const DataTypes& types, const Topology& topology);
     /// Write the Angles section
-    void write_angles(const DataTypes& types, const Topology& topology);
+    void write_angles(fmt::memory_buffer& buffer, const DataTypes& types, const Topology& topology);
     /// Write the Dihedrals section
-    void write_dihedrals(const DataTypes& types, const Topology& topology);
+    void write_dihedrals(fmt::memory_buffer& buffer, const DataTypes& types, const Topology& topology);
     /// Write the Impropers section
-    void write_impropers(const DataTypes& types, const Topology& topology);
+    void write_impropers(fmt::memory_buffer& buffer, const DataTypes& types, const Topology& topology);
 
     // =============== Data used for reading files
     /// Name of the atom style to use when reading the "Atoms" section
@@ -210,8 +238,10 @@ private:
     size_t nbonds_ = 0;
     /// Optional masses, indexed by atomic type
     std::unordered_map<std::string, double> masses_;
-    /// Optional atomic names, indexed by atomic indexes
-    std::vector<std::string> names_;
+    /// Optional atomic names, as a sparse list of (atomic index, name)
+    /// pairs. Most files only name a few atoms, so this stays small
+    /// instead of holding one default-constructed string per atom.
+    std::vector<std::pair<size_t, std::string>> names_;
 };
 
 template<> FormatInfo format_information<LAMMPSDataFormat>();
@@ -6,7 +6,8 @@
 
 #include <iosfwd>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "chemfiles/File.hpp"
 #include "chemfiles/Format.hpp"
@@ -28,7 +29,7 @@ public:
 
     void read_next(Frame& frame) override;
     void write_next(const Frame& frame) override;
-    std::streampos forward() override;
+    StepPosition forward() override;
 
 private:
     // Read Atoms
@@ -37,8 +38,10 @@ private:
     // Read Bonds
     void read_bonds(Frame& frame, size_t nbonds);
 
-    /// Map of residues, indexed by residue id.
-    std::unordered_map<size_t, Residue> residues_;
+    /// List of residues, sorted by residue id. MOL2 residue ids are
+    /// usually small and increasing, so a sorted vector is both more
+    /// compact and faster to fill than a hash map.
+    std::vector<std::pair<size_t, Residue>> residues_;
 };
 
 template<> FormatInfo format_information<MOL2Format>();
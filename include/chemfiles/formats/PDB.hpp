@@ -4,9 +4,10 @@
 #ifndef CHEMFILES_FORMAT_PDB_HPP
 #define CHEMFILES_FORMAT_PDB_HPP
 
-#include <map>
+#include <cstdint>
 #include <iosfwd>
 #include <string>
+#include <utility>
 #include <vector>
 #include <tuple>
 
@@ -32,7 +33,9 @@ public:
 
     void read_next(Frame& frame) override;
     void write_next(const Frame& frame) override;
-    std::streampos forward() override;
+    StepPosition forward() override;
+    bool can_parallelize_scan() const override;
+    bool can_split_at(const char* data, size_t length) const override;
 
     // Connect residues based on a predefined table
     static void link_standard_residue_bonds(Frame& frame);
@@ -52,24 +55,59 @@ private:
     // Runs when a chain is terminated to update residue information
     void chain_ended(Frame& frame);
 
-    /// This typedef represent the 'full' name of a residue, this means the
-    /// chainid, the residue sequence id, and the residue insertion code
-    using residue_info = std::tuple<char, size_t, char>;
+    /// This typedef represent the 'full' name of a residue -- the chainid,
+    /// the residue sequence id, and the residue insertion code -- packed in
+    /// a single integer, so that comparisons in the sorted containers below
+    /// are single integer operations.
+    using residue_info = uint64_t;
 
-    /// Map where the key is the residue_info and the value is a residue object
-    std::map<residue_info, Residue> residues_;
+    /// Pack the full name of a residue into a `residue_info`. The packed
+    /// values compare in (chainid, resid, insertion code) lexicographic
+    /// order; residue ids come from 4-characters wide fields and always fit
+    /// in the 48 bits available for them.
+    static residue_info encode_residue_info(char chain, size_t resid, char insertion_code) {
+        return (static_cast<uint64_t>(static_cast<unsigned char>(chain)) << 56) |
+               (static_cast<uint64_t>(resid) << 8) |
+                static_cast<uint64_t>(static_cast<unsigned char>(insertion_code));
+    }
+
+    /// Secondary structure kinds read from HELIX/SHEET/TURN records. The
+    /// corresponding property strings are only materialized when assigning
+    /// the "secondary_structure" residue property in `chain_ended`.
+    enum class Secondary {
+        ALPHA_HELIX,
+        OMEGA_HELIX,
+        PI_HELIX,
+        GAMMA_HELIX,
+        HELIX_3_10,
+        EXTENDED,
+    };
+
+    /// Get the value of the "secondary_structure" property for `kind`
+    static const char* secondary_name(Secondary kind);
+
+    /// List of (residue_info, residue) pairs, sorted by residue_info. PDB
+    /// files group the atoms of a residue together and order residues by
+    /// chain and id, so a sorted vector is cheaper to fill than a tree and
+    /// still supports the ordered range queries used for secondary
+    /// structure assignment.
+    std::vector<std::pair<residue_info, Residue>> residues_;
     /// Number of models written/read to the file.
     size_t models_ = 0;
     /// List of all atom offsets. This maybe pushed in read_ATOM or if a TER
     /// record is found. It is reset every time a frame is read.
     std::vector<size_t> atom_offsets_;
+    /// Map from the PDB atom id to the atom index in the frame, used to
+    /// resolve CONECT records with a single array lookup. Ids that could
+    /// not be parsed stay unset and go through `atom_offsets_` instead.
+    std::vector<size_t> pdb_id_map_;
     /// Did we wrote a frame to the file? This is used to check wheter we need
     /// to write a final `END` record in the destructor
     bool written_ = false;
     /// Store secondary structure information. Each item is a tuple, containing
-    /// the starting and ending residue_info of the seconary structure and a
-    /// string which is an written description of the secondary structure
-    std::vector<std::tuple<residue_info, residue_info, std::string>> secinfo_;
+    /// the starting and ending residue_info of the seconary structure and
+    /// the kind of the secondary structure
+    std::vector<std::tuple<residue_info, residue_info, Secondary>> secinfo_;
 };
 
 template<> FormatInfo format_information<PDBFormat>();
@@ -9,7 +9,9 @@
 
 #include "chemfiles/Format.hpp"
 #include "chemfiles/File.hpp"
+#include "chemfiles/Topology.hpp"
 #include "chemfiles/files/TNGFile.hpp"
+#include "chemfiles/external/optional.hpp"
 
 namespace chemfiles {
 class Frame;
@@ -44,6 +46,10 @@ private:
     std::vector<int64_t> tng_steps_;
     /// The number of atoms in the current frame
     int64_t natoms_ = 0;
+    /// Topology of the system, read once and reused for all frames: the
+    /// molecular system does not change along a TNG trajectory, and reading
+    /// it goes through thousands of small seek+read calls in the TNG library
+    optional<Topology> topology_ = nullopt;
 };
 
 template<> FormatInfo format_information<TNGFormat>();
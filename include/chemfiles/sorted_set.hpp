@@ -41,6 +41,7 @@ public:
     using super::max_size;
     using super::clear;
     using super::erase;
+    using super::reserve;
 
     std::pair<iterator, bool> insert(const value_type& value) {
         auto it = std::lower_bound(super::begin(), super::end(), value);
@@ -9,9 +9,11 @@
 
 #include "chemfiles/File.hpp"
 #include "chemfiles/files/GzFile.hpp"
+#include "chemfiles/files/MemoryMappedFile.hpp"
 #include "chemfiles/files/PlainFile.hpp"
 #include "chemfiles/files/XzFile.hpp"
 
+#include "chemfiles/Error.hpp"
 #include "chemfiles/ErrorFmt.hpp"
 #include "chemfiles/unreachable.hpp"
 
@@ -20,6 +22,16 @@ using namespace chemfiles;
 std::unique_ptr<TextFile> TextFile::open(std::string path, File::Mode mode, File::Compression compression) {
     switch (compression) {
     case File::DEFAULT:
+        if (mode == File::READ) {
+            // Read-only plain text files go through a memory-mapped view of
+            // the file: scanning a trajectory is then limited by memory
+            // bandwidth instead of syscall count. Fall back to standard
+            // buffered reads when mapping the file is not possible (empty
+            // file, pipe, etc.)
+            try {
+                return std::unique_ptr<TextFile>(new MemoryMappedFile(path));
+            } catch (const FileError&) {}
+        }
         return std::unique_ptr<TextFile>(new PlainFile(std::move(path), mode));
     case File::GZIP:
         return std::unique_ptr<TextFile>(new GzFile(std::move(path), mode));
@@ -104,11 +116,16 @@ void TextFile::rewind() {
 }
 
 std::string TextFile::readline() {
+    std::string line;
+    this->readline(line);
+    return line;
+}
+
+void TextFile::readline(std::string& line) {
     // Disable exceptions checking, and manually check bellow
     auto state = this->exceptions();
     this->exceptions(std::fstream::goodbit);
 
-    std::string line;
     get_line_impl(line);
     if (this->fail()) {
         throw file_error("could not read a line in {}", this->path());
@@ -116,7 +133,6 @@ std::string TextFile::readline() {
 
     // Re-enable exceptions checking
     this->exceptions(state);
-    return line;
 }
 
 std::vector<std::string> TextFile::readlines(size_t n) {
@@ -1,15 +1,22 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <istream>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
+#include <utility>
 #include <typeinfo>
+#include <algorithm>
 
 #include "chemfiles/File.hpp"
 #include "chemfiles/Format.hpp"
 #include "chemfiles/ErrorFmt.hpp"
+#include "chemfiles/files/MemoryMappedFile.hpp"
 
 namespace chemfiles {
     class Frame;
@@ -17,6 +24,82 @@ namespace chemfiles {
 
 using namespace chemfiles;
 
+// Branch prediction hint for conditions that are almost never true on the
+// hot path (error handling and one-time initialization)
+#ifdef __GNUC__
+#define CHFL_UNLIKELY(condition) __builtin_expect(static_cast<bool>(condition), false)
+#else
+#define CHFL_UNLIKELY(condition) (condition)
+#endif
+
+void StepPositions::reserve(size_t count) {
+    deltas_.reserve(count == 0 ? 0 : count - 1);
+    if (!natoms_.empty()) {
+        natoms_.reserve(count);
+    }
+}
+
+void StepPositions::push_back(StepPosition step) {
+    auto position = static_cast<uint64_t>(static_cast<std::streamoff>(step.position));
+    if (count_ == 0) {
+        base_ = position;
+        cursor_index_ = 0;
+        cursor_position_ = position;
+    } else {
+        assert(position >= back_);
+        auto distance = position - back_;
+        if (CHFL_UNLIKELY(distance >= UINT32_MAX)) {
+            overflow_.emplace_back(count_ - 1, distance);
+            deltas_.push_back(UINT32_MAX);
+        } else {
+            deltas_.push_back(static_cast<uint32_t>(distance));
+        }
+    }
+    back_ = position;
+    count_++;
+
+    if (step.natoms) {
+        if (natoms_.size() < count_ - 1) {
+            natoms_.resize(count_ - 1, UINT64_MAX);
+        }
+        natoms_.push_back(*step.natoms);
+    } else if (!natoms_.empty()) {
+        natoms_.push_back(UINT64_MAX);
+    }
+}
+
+uint64_t StepPositions::delta(size_t index) const {
+    auto value = deltas_[index];
+    if (CHFL_UNLIKELY(value == UINT32_MAX)) {
+        auto it = std::lower_bound(overflow_.begin(), overflow_.end(), index,
+            [](const std::pair<size_t, uint64_t>& entry, size_t i) {
+                return entry.first < i;
+            }
+        );
+        assert(it != overflow_.end() && it->first == index);
+        return it->second;
+    }
+    return value;
+}
+
+StepPosition StepPositions::operator[](size_t index) const {
+    assert(index < count_);
+    while (cursor_index_ < index) {
+        cursor_position_ += delta(cursor_index_);
+        cursor_index_++;
+    }
+    while (cursor_index_ > index) {
+        cursor_index_--;
+        cursor_position_ -= delta(cursor_index_);
+    }
+
+    auto position = std::streampos(static_cast<std::streamoff>(cursor_position_));
+    if (index < natoms_.size() && natoms_[index] != UINT64_MAX) {
+        return {position, static_cast<size_t>(natoms_[index])};
+    }
+    return position;
+}
+
 void Format::read_step(size_t /*unused*/, Frame& /*unused*/) {
     throw format_error(
         "'read_step' is not implemented for this format ({})",
@@ -42,21 +125,61 @@ void Format::write(const Frame& /*unused*/) {
 TextFormat::TextFormat(std::string path, File::Mode mode, File::Compression compression):
     file_(TextFile::open(std::move(path), mode, compression)) {}
 
+bool TextFormat::can_split_at(const char* /*unused*/, size_t /*unused*/) const {
+    throw format_error(
+        "'can_split_at' is not implemented for this format ({})",
+        typeid(*this).name()
+    );
+}
+
+/// Only use multiple threads to scan memory-mapped files bigger than this
+static const size_t PARALLEL_SCAN_THRESHOLD = 16 * 1024 * 1024;
+
 void TextFormat::scan_all() {
-    if (eof_found_) {
+    if (CHFL_UNLIKELY(eof_found_)) {
         return;
     }
 
     auto before = file_->tellg();
+
+    if (steps_positions_.empty() && can_parallelize_scan()) {
+        auto mapped = dynamic_cast<MemoryMappedFile*>(file_.get());
+        if (mapped != nullptr && mapped->size() >= PARALLEL_SCAN_THRESHOLD) {
+            parallel_scan(mapped->data(), mapped->size());
+            eof_found_ = true;
+            if (before == std::streampos(0) && !steps_positions_.empty()) {
+                file_->seekg(steps_positions_[0].position);
+            } else {
+                file_->seekg(before);
+            }
+            return;
+        }
+    }
+
+    bool reserved = false;
     while (!file_->eof()) {
-        auto position = forward();
-        if (position == std::streampos(-1)) {
+        auto step = forward();
+        if (step.position == std::streampos(-1)) {
             break;
         }
         if (!file_) {
             throw format_error("IO error while reading '{}'", file_->path());
         }
-        steps_positions_.push_back(position);
+        steps_positions_.push_back(step);
+
+        if (!reserved) {
+            // Use the size of the first scanned step to estimate the number
+            // of steps in the file, and reserve the index in one go instead
+            // of growing it O(log n) times
+            reserved = true;
+            auto mapped = dynamic_cast<MemoryMappedFile*>(file_.get());
+            auto step_size = file_->tellg() - step.position;
+            if (mapped != nullptr && step_size > 0) {
+                steps_positions_.reserve(
+                    steps_positions_.size() + mapped->size() / static_cast<size_t>(step_size) + 1
+                );
+            }
+        }
     }
 
     eof_found_ = true;
@@ -64,21 +187,76 @@ void TextFormat::scan_all() {
     file_->clear();
 
     if (before == std::streampos(0) && !steps_positions_.empty()) {
-        file_->seekg(steps_positions_[0]);
+        file_->seekg(steps_positions_[0].position);
     } else {
         file_->seekg(before);
     }
 }
 
+void TextFormat::parallel_scan(const char* data, size_t size) {
+    auto nthreads = static_cast<size_t>(std::thread::hardware_concurrency());
+    if (nthreads == 0) {
+        nthreads = 1;
+    }
+
+    // Split the file in roughly equal byte ranges, and have each thread look
+    // for steps starting in its own range. A step starts at the beginning of
+    // a line, so the threads walk from one line start to the next with
+    // memchr, and ask `can_split_at` to validate each candidate.
+    auto results = std::vector<std::vector<StepPosition>>(nthreads);
+    auto workers = std::vector<std::thread>();
+    for (size_t t = 0; t < nthreads; t++) {
+        workers.emplace_back([&, t]() {
+            size_t begin = size * t / nthreads;
+            size_t end = size * (t + 1) / nthreads;
+
+            const char* line = nullptr;
+            if (begin == 0) {
+                line = data;
+            } else {
+                // The first full line of this range starts right after the
+                // first newline at or after `begin - 1`
+                auto eol = static_cast<const char*>(
+                    std::memchr(data + begin - 1, '\n', size - begin + 1)
+                );
+                line = (eol == nullptr) ? nullptr : eol + 1;
+            }
+
+            while (line != nullptr && line < data + end) {
+                size_t offset = static_cast<size_t>(line - data);
+                if (can_split_at(line, size - offset)) {
+                    results[t].push_back(std::streampos(static_cast<std::streamoff>(offset)));
+                }
+                auto eol = static_cast<const char*>(
+                    std::memchr(line, '\n', size - offset)
+                );
+                line = (eol == nullptr) ? nullptr : eol + 1;
+            }
+        });
+    }
+
+    for (auto& worker: workers) {
+        worker.join();
+    }
+
+    // Each thread produced sorted positions for its own byte range, so
+    // concatenating them in order keeps the whole list sorted
+    for (auto& result: results) {
+        for (auto& step: result) {
+            steps_positions_.push_back(step);
+        }
+    }
+}
+
 void TextFormat::read_step(size_t step, Frame& frame) {
     // Start by checking if we know this step, if not, look for all steps in
     // the file
-    if (step >= steps_positions_.size()) {
+    if (CHFL_UNLIKELY(step >= steps_positions_.size())) {
         scan_all();
     }
 
     // If the step is still too big, this is an error
-    if (step >= steps_positions_.size()) {
+    if (CHFL_UNLIKELY(step >= steps_positions_.size())) {
         if (steps_positions_.size() == 0) {
             throw file_error(
                 "can not read file '{}' at step {}, it does not contain any step",
@@ -92,20 +270,35 @@ void TextFormat::read_step(size_t step, Frame& frame) {
         }
     }
 
-    file_->seekg(steps_positions_[step]);
+    file_->seekg(steps_positions_[step].position);
+    natoms_hint_ = steps_positions_[step].natoms;
     read_next(frame);
+    natoms_hint_ = nullopt;
+    current_step_ = step + 1;
 }
 
 void TextFormat::read(Frame& frame) {
-    auto position = file_->tellg();
-    read_next(frame);
-    // If no exception was thrown, we can add this step to the list
-    steps_positions_.push_back(position);
+    if (current_step_ < steps_positions_.size()) {
+        // This step was already indexed by a previous scan or read, reuse
+        // the data cached at that point instead of re-parsing it
+        file_->seekg(steps_positions_[current_step_].position);
+        natoms_hint_ = steps_positions_[current_step_].natoms;
+        read_next(frame);
+        natoms_hint_ = nullopt;
+    } else {
+        auto position = file_->tellg();
+        natoms_hint_ = nullopt;
+        read_next(frame);
+        // If no exception was thrown, we can add this step to the list
+        steps_positions_.push_back(position);
+    }
+    current_step_++;
 }
 
 void TextFormat::write(const Frame& frame) {
     write_next(frame);
     steps_positions_.push_back(file_->tellg());
+    current_step_ = steps_positions_.size();
 }
 
 size_t TextFormat::nsteps() {
@@ -47,6 +47,11 @@ void Frame::reserve(size_t size) {
     }
 }
 
+void Frame::reserve_atoms(size_t size) {
+    resize(0);
+    reserve(size);
+}
+
 void Frame::add_velocities() {
     if (!velocities_) {
         velocities_ = std::vector<Vector3D>(size());
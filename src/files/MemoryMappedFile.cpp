@@ -0,0 +1,211 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <ios>
+#include <cstring>
+#include <istream>
+#include <string>
+
+#include "chemfiles/File.hpp"
+#include "chemfiles/files/MemoryMappedFile.hpp"
+#include "chemfiles/ErrorFmt.hpp"
+
+#ifdef CHEMFILES_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace chemfiles;
+
+#ifdef CHEMFILES_WINDOWS
+
+memory_mapped_buffer::memory_mapped_buffer(const std::string& path) {
+    auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw file_error("could not open the file at '{}'", path);
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) == 0 || size.QuadPart == 0) {
+        CloseHandle(file);
+        throw file_error("could not memory map the file at '{}'", path);
+    }
+
+    auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The file handle can be closed as soon as the mapping exists
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        throw file_error("could not memory map the file at '{}'", path);
+    }
+
+    auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == nullptr) {
+        throw file_error("could not memory map the file at '{}'", path);
+    }
+
+    data_ = static_cast<char*>(data);
+    size_ = static_cast<size_t>(size.QuadPart);
+    this->setg(data_, data_, data_ + size_);
+}
+
+memory_mapped_buffer::~memory_mapped_buffer() {
+    UnmapViewOfFile(data_);
+}
+
+#else
+
+memory_mapped_buffer::memory_mapped_buffer(const std::string& path) {
+    auto descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor == -1) {
+        throw file_error("could not open the file at '{}'", path);
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) == -1 || !S_ISREG(status.st_mode) || status.st_size == 0) {
+        close(descriptor);
+        throw file_error("could not memory map the file at '{}'", path);
+    }
+
+    auto size = static_cast<size_t>(status.st_size);
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    // The file descriptor can be closed as soon as the mapping exists
+    close(descriptor);
+    if (data == MAP_FAILED) {
+        throw file_error("could not memory map the file at '{}'", path);
+    }
+
+    data_ = static_cast<char*>(data);
+    size_ = size;
+    this->setg(data_, data_, data_ + size_);
+}
+
+memory_mapped_buffer::~memory_mapped_buffer() {
+    munmap(data_, size_);
+}
+
+#endif
+
+std::streambuf::int_type memory_mapped_buffer::underflow() {
+    // The whole file is the get area, so running out of characters to read
+    // always is the end of the file
+    return traits_type::eof();
+}
+
+std::streambuf::pos_type memory_mapped_buffer::seekoff(
+    off_type offset, std::ios_base::seekdir way, std::ios_base::openmode which
+) {
+    if ((which & std::ios_base::in) == 0) {
+        return pos_type(off_type(-1));
+    }
+
+    off_type position = 0;
+    if (way == std::ios_base::beg) {
+        position = offset;
+    } else if (way == std::ios_base::cur) {
+        position = (this->gptr() - this->eback()) + offset;
+    } else {
+        position = static_cast<off_type>(size_) + offset;
+    }
+
+    return this->seekpos(pos_type(position), which);
+}
+
+std::streambuf::pos_type memory_mapped_buffer::seekpos(
+    pos_type position, std::ios_base::openmode which
+) {
+    auto offset = off_type(position);
+    if ((which & std::ios_base::in) == 0 || offset < 0 || offset > static_cast<off_type>(size_)) {
+        return pos_type(off_type(-1));
+    }
+
+    this->setg(data_, data_ + offset, data_ + size_);
+    return position;
+}
+
+char* memory_mapped_buffer::end_of_line(char* current, char* end) {
+    auto length = static_cast<size_t>(end - current);
+    auto* lf = static_cast<char*>(memchr(current, '\n', length));
+    // Limit the carriage return search to the characters before the line
+    // feed: a '\r' after it belongs to one of the next lines
+    auto limit = lf == nullptr ? length : static_cast<size_t>(lf - current);
+    auto* cr = static_cast<char*>(memchr(current, '\r', limit));
+    return cr == nullptr ? lf : cr;
+}
+
+bool memory_mapped_buffer::getline(std::string& line) {
+    auto* current = this->gptr();
+    auto* end = this->egptr();
+    if (current == end) {
+        return false;
+    }
+
+    auto* eol = end_of_line(current, end);
+    if (eol == nullptr) {
+        // last line of a file without a final end of line marker
+        line.append(current, end);
+        this->setg(data_, end, end);
+        return true;
+    }
+
+    line.append(current, eol);
+    auto* next = eol + 1;
+    if (*eol == '\r' && next != end && *next == '\n') {
+        next++;
+    }
+    this->setg(data_, next, end);
+    return true;
+}
+
+bool memory_mapped_buffer::skipline() {
+    auto* current = this->gptr();
+    auto* end = this->egptr();
+
+    auto* eol = end_of_line(current, end);
+    if (eol == nullptr) {
+        this->setg(data_, end, end);
+        return false;
+    }
+
+    auto* next = eol + 1;
+    if (*eol == '\r' && next != end && *next == '\n') {
+        next++;
+    }
+    this->setg(data_, next, end);
+    return true;
+}
+
+MemoryMappedFile::MemoryMappedFile(std::string path):
+    TextFile(std::move(path), File::READ, File::DEFAULT, &buffer_),
+    buffer_(this->path()) {}
+
+void MemoryMappedFile::get_line_impl(std::string& line) {
+    line.clear();
+    // The sentry checks the stream state before the read, setting the fail
+    // bit when the stream is already past the end of the file, exactly like
+    // the generic character-by-character implementation does.
+    std::istream::sentry sentry(*this, true);
+    if (!sentry) {
+        return;
+    }
+
+    if (!buffer_.getline(line)) {
+        this->setstate(std::ios::eofbit);
+    }
+}
+
+void MemoryMappedFile::skip_line_impl() {
+    std::istream::sentry sentry(*this, true);
+    if (!sentry) {
+        return;
+    }
+
+    if (!buffer_.skipline()) {
+        this->setstate(std::ios::eofbit);
+    }
+}
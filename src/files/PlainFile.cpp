@@ -21,6 +21,11 @@ PlainFile::PlainFile(std::string path, File::Mode mode)
     // `get_line` function.
     std::ios_base::openmode openmode = std::ios_base::binary;
 
+    // use a larger buffer than the implementation default (usually a few
+    // KiB); this has to be done before opening the file to be portable
+    stream_buffer_.resize(256 * 1024);
+    buffer_.pubsetbuf(stream_buffer_.data(), static_cast<std::streamsize>(stream_buffer_.size()));
+
     switch (mode) {
     case File::READ:
         openmode |= std::ios_base::in;
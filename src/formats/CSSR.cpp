@@ -5,6 +5,8 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <utility>
+#include <cstdlib>
 #include <istream>
 
 #include <fmt/ostream.h>
@@ -27,8 +29,47 @@
 using namespace chemfiles;
 
 static bool is_digit(char c) {
-    return c == '0' || c == '1' || c == '2' || c == '3' || c == '4' ||
-           c == '5' || c == '6' || c == '7' || c == '8' || c == '9';
+    // single unsigned compare instead of a chain of equality tests
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+static const char* move_past_whitespace(const char* it, const char* end) {
+    while (it != end && (*it == ' ' || *it == '\t')) {
+        it++;
+    }
+    return it;
+}
+
+/// Read a single unsigned integer starting at `it`, moving `it` past the
+/// parsed digits
+static unsigned read_unsigned(const char*& it, const char* end, const std::string& line) {
+    it = move_past_whitespace(it, end);
+    unsigned value = 0;
+    size_t digits = 0;
+    while (it != end && is_digit(*it)) {
+        value = 10 * value + static_cast<unsigned>(*it - '0');
+        it++;
+        digits++;
+    }
+    if (digits == 0) {
+        throw error("missing integer field in CSSR atom line '{}'", line);
+    }
+    return value;
+}
+
+/// Read a single floating point value starting at `it`, moving `it` past the
+/// parsed characters
+static double read_double(const char*& it, const char* end, const std::string& line) {
+    it = move_past_whitespace(it, end);
+    // `it` points inside the null-terminated buffer of `line`, so strtod
+    // will stop at the end of the line at the latest
+    char* stop = nullptr;
+    double value = std::strtod(it, &stop);
+    if (stop == it) {
+        throw error("missing floating point field in CSSR atom line '{}'", line);
+    }
+    it = stop;
+    return value;
 }
 
 
@@ -67,21 +108,41 @@ void CSSRFormat::read_next(Frame& frame) {
     // Title line
     file_->skipline();
 
-    frame.resize(0);
-    frame.reserve(natoms);
+    frame.reserve_atoms(natoms);
 
-    std::vector<std::vector<size_t>> connectivity(natoms);
+    // Flat list of bonds found on the atom lines, stored until all the
+    // atoms exist in the frame. A single flat vector replaces the previous
+    // one-vector-per-atom connectivity, removing natoms small allocations.
+    std::vector<std::pair<size_t, size_t>> pending_bonds;
     for (auto&& line: file_->readlines(natoms)) {
-        unsigned atom_id = 0;
+        // Parse the line with a single pass over the characters: this is
+        // the hot loop of CSSR reading, and sscanf-style parsing needs to
+        // re-interpret the format string for every field
+        const char* it = line.c_str();
+        const char* end = it + line.length();
+
+        unsigned atom_id = read_unsigned(it, end, line);
+
+        it = move_past_whitespace(it, end);
         char name[5] = {0};
-        double x = 0, y = 0, z = 0;
+        size_t name_length = 0;
+        while (it != end && name_length < 4 && *it != ' ' && *it != '\t') {
+            name[name_length++] = *it++;
+        }
+        if (name_length == 0) {
+            throw error("missing atom name in CSSR atom line '{}'", line);
+        }
+
+        double x = read_double(it, end, line);
+        double y = read_double(it, end, line);
+        double z = read_double(it, end, line);
+
         unsigned bonds[8] = {0};
-        double charge = 0;
+        for (auto& bond: bonds) {
+            bond = read_unsigned(it, end, line);
+        }
 
-        scan(line, "%u %4s %lf %lf %lf %u %u %u %u %u %u %u %u %lf",
-            &atom_id, &name[0], &x, &y, &z, &bonds[0], &bonds[1], &bonds[2],
-            &bonds[3], &bonds[4], &bonds[5], &bonds[6], &bonds[7], &charge
-        );
+        double charge = read_double(it, end, line);
 
         auto position = Vector3D(x, y, z);
         if (use_fractional) {
@@ -89,31 +150,24 @@ void CSSRFormat::read_next(Frame& frame) {
         }
 
         // Atomic names can be created as <type><id>: O121 H22
-        auto type = std::string(name);
         size_t type_length = 0;
-        for (auto ch: type) {
-            if (is_digit(ch)) {
-                break;
-            }
+        while (type_length < name_length && !is_digit(name[type_length])) {
             type_length += 1;
         }
-        type = type.substr(0, type_length);
 
-        auto atom = Atom(name, type);
+        auto atom = Atom(name, std::string(name, type_length));
         atom.set_charge(charge);
         frame.add_atom(std::move(atom), position);
 
         for (auto bond: bonds) {
             if (bond != 0) {
-                connectivity[atom_id - 1].push_back(bond - 1);
+                pending_bonds.emplace_back(atom_id - 1, bond - 1);
             }
         }
     }
 
-    for (size_t i=0; i<natoms; i++) {
-        for (auto j: connectivity[i]) {
-            frame.add_bond(i, j);
-        }
+    for (auto& bond: pending_bonds) {
+        frame.add_bond(bond.first, bond.second);
     }
 }
 
@@ -122,69 +176,107 @@ void CSSRFormat::write_next(const Frame& frame) {
         throw format_error("CSSR format only supports writing one frame");
     }
 
-    fmt::print(
-        *file_, " REFERENCE STRUCTURE = 00000   A,B,C ={:8.3f}{:8.3f}{:8.3f}\n",
+    // Format the whole frame in memory first, then write it to the file in
+    // a single operation instead of one write per line
+    auto buffer = fmt::memory_buffer();
+    fmt::format_to(
+        buffer, " REFERENCE STRUCTURE = 00000   A,B,C ={:8.3f}{:8.3f}{:8.3f}\n",
         frame.cell().a(), frame.cell().b(), frame.cell().c()
     );
-    fmt::print(
-        *file_, "   ALPHA,BETA,GAMMA ={:8.3f}{:8.3f}{:8.3f}    SPGR =  1 P1\n",
+    fmt::format_to(
+        buffer, "   ALPHA,BETA,GAMMA ={:8.3f}{:8.3f}{:8.3f}    SPGR =  1 P1\n",
         frame.cell().alpha(), frame.cell().beta(), frame.cell().gamma()
     );
 
     if (frame.size() > 9999) {
         warning("CCSR writer", "too many atoms, the file might not open with other programs");
-        fmt::print(*file_, "{} 0\n", frame.size());
+        fmt::format_to(buffer, "{} 0\n", frame.size());
     } else {
-        fmt::print(*file_, "{:4}   0\n", frame.size());
+        fmt::format_to(buffer, "{:4}   0\n", frame.size());
     }
 
     // TODO: use the frame name/title property in the file title
-    fmt::print(*file_, " file created with chemfiles\n", frame.size());
-
-    auto connectivity = std::vector<std::vector<size_t>>(frame.size());
-    for (auto& bond : frame.topology().bonds()) {
+    fmt::format_to(buffer, " file created with chemfiles\n", frame.size());
+
+    // Store the connectivity in CSR layout (a flat neighbors array indexed
+    // by an offsets array) instead of one vector per atom: count the
+    // neighbors of every atom, compute the prefix sum, then fill
+    auto& frame_bonds = frame.topology().bonds();
+    auto offsets = std::vector<size_t>(frame.size() + 1, 0);
+    for (auto& bond : frame_bonds) {
         if (bond[0] > 9999 || bond[1] > 9999) {
             warning("CCSR writer", "atomic index is too big for connectivity record, removing the bond");
             continue;
         }
-        connectivity[bond[0]].push_back(bond[1]);
-        connectivity[bond[1]].push_back(bond[0]);
+        offsets[bond[0] + 1]++;
+        offsets[bond[1] + 1]++;
+    }
+    for (size_t i = 0; i<frame.size(); i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    auto neighbors = std::vector<size_t>(offsets.back(), 0);
+    auto cursors = offsets;
+    for (auto& bond : frame_bonds) {
+        if (bond[0] > 9999 || bond[1] > 9999) {
+            // Already warned about this bond in the first pass
+            continue;
+        }
+        neighbors[cursors[bond[0]]++] = bond[1];
+        neighbors[cursors[bond[1]]++] = bond[0];
     }
 
     auto& positions = frame.positions();
     auto cell_inv = frame.cell().matrix().invert();
-    for (size_t i = 0; i<frame.size(); i++) {
-        std::string atom_id;
+
+    // Convert all the positions to fractional coordinates before formatting
+    // them: with one tight loop per output array, the compiler is able to
+    // vectorize the matrix product across atoms
+    auto natoms = frame.size();
+    auto fractional_x = std::vector<double>(natoms);
+    auto fractional_y = std::vector<double>(natoms);
+    auto fractional_z = std::vector<double>(natoms);
+    for (size_t i = 0; i<natoms; i++) {
+        auto& position = positions[i];
+        fractional_x[i] = cell_inv[0][0] * position[0] + cell_inv[0][1] * position[1] + cell_inv[0][2] * position[2];
+        fractional_y[i] = cell_inv[1][0] * position[0] + cell_inv[1][1] * position[1] + cell_inv[1][2] * position[2];
+        fractional_z[i] = cell_inv[2][0] * position[0] + cell_inv[2][1] * position[1] + cell_inv[2][2] * position[2];
+    }
+
+    for (size_t i = 0; i<natoms; i++) {
+        // Format the atom id without going through std::to_string, which
+        // allocates for every atom
         if (i <= 9999) {
-            atom_id = std::to_string(i + 1);
+            fmt::format_to(buffer, "{:<4} ", i + 1);
         } else {
-            atom_id = "****";
+            fmt::format_to(buffer, "**** ");
         }
 
-        auto fractional = cell_inv * positions[i];
-        fmt::print(*file_, "{:4} {:4}  {:9.5f} {:9.5f} {:9.5f}",
-            atom_id, frame[i].name(), fractional[0], fractional[1], fractional[2]
+        fmt::format_to(buffer, "{:4}  {:9.5f} {:9.5f} {:9.5f}",
+            frame[i].name(), fractional_x[i], fractional_y[i], fractional_z[i]
         );
 
         auto bonds = 0;
-        for (auto bond: connectivity[i]) {
+        for (size_t j = offsets[i]; j < offsets[i + 1]; j++) {
             if (bonds >= 8) {
                 warning("CCSR writer", "too many bonds with atom {}, only 8 are supported", i);
                 break;
             }
-            fmt::print(*file_, "{:4}", bond + 1);
+            fmt::format_to(buffer, "{:4}", neighbors[j] + 1);
             bonds += 1;
         }
         while (bonds < 8) {
-            fmt::print(*file_, "   0");
+            fmt::format_to(buffer, "   0");
             bonds += 1;
         }
 
-        fmt::print(*file_, " {:7.3f}\n", frame[i].charge());
+        fmt::format_to(buffer, " {:7.3f}\n", frame[i].charge());
     }
+
+    file_->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 }
 
-std::streampos CSSRFormat::forward() {
+StepPosition CSSRFormat::forward() {
     // CSSR only supports one step, so always act like there is only one
     auto position = file_->tellg();
     if (position == std::streampos(0)) {
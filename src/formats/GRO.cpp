@@ -1,12 +1,17 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
-#include <map>
 #include <array>
+#include <utility>
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
 #include <cassert>
 #include <istream>
 
@@ -42,45 +47,158 @@ template<> FormatInfo chemfiles::format_information<GROFormat>() {
 /// message
 static void check_values_size(const Vector3D& values, unsigned width, const std::string& context);
 
+/// Parse the floating point value in the fixed-width field starting at
+/// `line[start]`, without allocating a substring
+static double read_float_field(const std::string& line, size_t start, size_t width) {
+    char buffer[16];
+    assert(width < sizeof(buffer));
+    std::memcpy(buffer, line.data() + start, width);
+    buffer[width] = '\0';
+
+    char* stop = nullptr;
+    double value = std::strtod(buffer, &stop);
+    while (*stop == ' ' || *stop == '\t') {
+        stop++;
+    }
+    if (stop == buffer || *stop != '\0') {
+        throw format_error("can not parse number in GRO line '{}'", line);
+    }
+    return value;
+}
+
+/// Get the content of the fixed-width field starting at `line[start]`, with
+/// the surrounding whitespace removed
+static std::string read_string_field(const std::string& line, size_t start, size_t width) {
+    auto begin = line.data() + start;
+    auto end = begin + width;
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        begin++;
+    }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    return std::string(begin, end);
+}
+
+/// Parse the atom count line into `natoms`, returning `false` if the line
+/// does not contain a single positive integer
+static bool parse_atom_count(const std::string& line, size_t& natoms) {
+    auto it = line.data();
+    auto end = it + line.length();
+    while (it < end && (*it == ' ' || *it == '\t')) {
+        it++;
+    }
+    natoms = 0;
+    size_t digits = 0;
+    while (it < end && *it >= '0' && *it <= '9') {
+        natoms = 10 * natoms + static_cast<size_t>(*it - '0');
+        it++;
+        digits++;
+    }
+    while (it < end && (*it == ' ' || *it == '\t' || *it == '\r')) {
+        it++;
+    }
+    return digits != 0 && it == end;
+}
+
+/// Parse the whitespace-separated floating point values in the box line
+/// into `values`, returning how many values the line contains. Values past
+/// the ninth are not stored, but still counted. This replaces a
+/// split + parse<double> combination which allocated one string per value.
+static size_t parse_box_values(const std::string& line, double (&values)[9]) {
+    auto it = line.c_str();
+    size_t count = 0;
+    while (true) {
+        char* stop = nullptr;
+        double value = std::strtod(it, &stop);
+        if (stop == it) {
+            break;
+        }
+        if (count < 9) {
+            values[count] = value;
+        }
+        count++;
+        it = stop;
+    }
+    return count;
+}
+
+/// Parse the residue id in the first five columns of `line`, returning
+/// `SIZE_MAX` if the field is not a valid integer
+static size_t read_resid_field(const std::string& line) {
+    auto it = line.data();
+    auto end = it + 5;
+    while (it < end && *it == ' ') {
+        it++;
+    }
+    size_t resid = 0;
+    size_t digits = 0;
+    while (it < end && *it >= '0' && *it <= '9') {
+        resid = 10 * resid + static_cast<size_t>(*it - '0');
+        it++;
+        digits++;
+    }
+    if (digits == 0 || it != end) {
+        return SIZE_MAX;
+    }
+    return resid;
+}
+
 void GROFormat::read_next(Frame& frame) {
     size_t natoms = 0;
     try {
         frame.set("name", trim(file_->readline())); // GRO comment line;
-        natoms = parse<size_t>(file_->readline());
-    } catch (const Error& e) {
+        if (natoms_hint_) {
+            // the atom count was already parsed while scanning the file
+            natoms = *natoms_hint_;
+            file_->skipline();
+        } else {
+            // Check the atom count without going through a throwing parse:
+            // exceptions here would sit on the path taken for every frame
+            auto line = file_->readline();
+            if (!parse_atom_count(line, natoms)) {
+                throw format_error(
+                    "can not read next step as GRO: can not convert '{}' to an integer",
+                    trim(line)
+                );
+            }
+        }
+    } catch (const FileError& e) {
         throw format_error("can not read next step as GRO: {}", e.what());
     }
 
     residues_.clear();
+    // Rough estimate of the number of residues, to pre-allocate the
+    // storage before the per-atom loop
+    residues_.reserve(natoms / 8);
     frame.add_velocities();
-    frame.reserve(natoms);
-    frame.resize(0);
+    frame.reserve_atoms(natoms);
 
-    for (auto&& line: file_->readlines(natoms)) {
+    // Reuse the same line buffer for the whole loop instead of allocating
+    // a fresh string for every atom line
+    std::string line;
+    for (size_t i = 0; i<natoms; i++) {
+        file_->readline(line);
         if (line.length() < 44) {
             throw format_error(
                 "GRO Atom line is too small: '{}'", line
             );
         }
 
-        size_t resid = SIZE_MAX;
-        try {
-            resid = parse<size_t>(line.substr(0, 5));
-        } catch (const Error&) {
-            // Invalid residue, we'll skip it
-        }
-        auto resname = trim(line.substr(5, 5));
-        auto name = trim(line.substr(10, 5));
+        // If the residue id is invalid, we'll skip the residue
+        size_t resid = read_resid_field(line);
+        auto resname = read_string_field(line, 5, 5);
+        auto name = read_string_field(line, 10, 5);
 
         // GRO files store atoms in NM, we need to convert to Angstroms
-        auto x = parse<double>(line.substr(20, 8)) * 10;
-        auto y = parse<double>(line.substr(28, 8)) * 10;
-        auto z = parse<double>(line.substr(36, 8)) * 10;
+        auto x = read_float_field(line, 20, 8) * 10;
+        auto y = read_float_field(line, 28, 8) * 10;
+        auto z = read_float_field(line, 36, 8) * 10;
 
         if (line.length() >= 68) {
-            auto vx = parse<double>(line.substr(44, 8)) * 10;
-            auto vy = parse<double>(line.substr(52, 8)) * 10;
-            auto vz = parse<double>(line.substr(60, 8)) * 10;
+            auto vx = read_float_field(line, 44, 8) * 10;
+            auto vy = read_float_field(line, 52, 8) * 10;
+            auto vz = read_float_field(line, 60, 8) * 10;
 
             frame.add_atom(Atom(name),
                 Vector3D(x, y, z),
@@ -93,42 +211,60 @@ void GROFormat::read_next(Frame& frame) {
         }
 
         if (resid != SIZE_MAX) {
-            if (residues_.find(resid) == residues_.end()) {
+            if (!residues_.empty() && residues_.back().first == resid) {
+                // Fast path: this atom is in the same residue as the
+                // previous one
+                residues_.back().second.add_atom(frame.size() - 1);
+            } else if (residues_.empty() || resid > residues_.back().first) {
                 Residue residue(resname, resid);
                 residue.add_atom(frame.size() - 1);
 
-                residues_.insert({resid, residue});
+                residues_.emplace_back(resid, std::move(residue));
             } else {
-                // Just add this atom to the residue
-                residues_.at(resid).add_atom(frame.size() - 1);
+                // Out of order residue id, find where it belongs to keep
+                // the list sorted
+                auto it = std::lower_bound(residues_.begin(), residues_.end(), resid,
+                    [](const std::pair<size_t, Residue>& entry, size_t id) {
+                        return entry.first < id;
+                    }
+                );
+                if (it != residues_.end() && it->first == resid) {
+                    it->second.add_atom(frame.size() - 1);
+                } else {
+                    Residue residue(resname, resid);
+                    residue.add_atom(frame.size() - 1);
+
+                    residues_.insert(it, {resid, std::move(residue)});
+                }
             }
         }
     }
 
-    std::string box = file_->readline();
-    auto box_values = split(box, ' ');
+    file_->readline(line);
+    double box_values[9] = {0};
+    auto box_size = parse_box_values(line, box_values);
 
-    if (box_values.size() == 3) {
-        auto a = parse<double>(box_values[0]) * 10;
-        auto b = parse<double>(box_values[1]) * 10;
-        auto c = parse<double>(box_values[2]) * 10;
+    if (box_size == 3) {
+        auto a = box_values[0] * 10;
+        auto b = box_values[1] * 10;
+        auto c = box_values[2] * 10;
 
         auto cell = UnitCell(a, b, c);
         frame.set_cell(cell);
-    } else if (box_values.size() == 9) {
-        auto v1_x = parse<double>(box_values[0]) * 10;
-        auto v2_y = parse<double>(box_values[1]) * 10;
-        auto v3_z = parse<double>(box_values[2]) * 10;
+    } else if (box_size == 9) {
+        auto v1_x = box_values[0] * 10;
+        auto v2_y = box_values[1] * 10;
+        auto v3_z = box_values[2] * 10;
 
-        assert(parse<double>(box_values[3]) == 0);
-        assert(parse<double>(box_values[4]) == 0);
+        assert(box_values[3] == 0);
+        assert(box_values[4] == 0);
 
-        auto v2_x = parse<double>(box_values[5]) * 10;
+        auto v2_x = box_values[5] * 10;
 
-        assert(parse<double>(box_values[6]) == 0);
+        assert(box_values[6] == 0);
 
-        auto v3_x = parse<double>(box_values[7]) * 10;
-        auto v3_y = parse<double>(box_values[8]) * 10;
+        auto v3_x = box_values[7] * 10;
+        auto v3_y = box_values[8] * 10;
 
         auto H = Matrix3D(
             v1_x, v2_x, v3_x,
@@ -145,7 +281,94 @@ void GROFormat::read_next(Frame& frame) {
     }
 }
 
-static std::string to_gro_index(uint64_t i) {
+/// Format `value` as decimal digits at the end of `buffer`, returning a
+/// pointer to the first digit. This avoids the allocation and locale of
+/// std::to_string in the per-atom write loop.
+static const char* format_index(uint64_t value, char (&buffer)[8]) {
+    char* cursor = buffer + sizeof(buffer) - 1;
+    *cursor = '\0';
+    do {
+        *--cursor = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return cursor;
+}
+
+/// Append `value` to the buffer, right-aligned in a field of at least
+/// `width` characters
+static void append_right(fmt::memory_buffer& buffer, const char* value, size_t length, size_t width) {
+    for (size_t i = length; i < width; i++) {
+        buffer.push_back(' ');
+    }
+    buffer.append(value, value + length);
+}
+
+/// Append `value` to the buffer, left-aligned in a field of at least
+/// `width` characters
+static void append_left(fmt::memory_buffer& buffer, const std::string& value, size_t width) {
+    buffer.append(value.data(), value.data() + value.length());
+    for (size_t i = value.length(); i < width; i++) {
+        buffer.push_back(' ');
+    }
+}
+
+/// Append `value` to the buffer with `precision` digits after the decimal
+/// separator, right-aligned in a field of at least `width` characters.
+///
+/// GRO atom lines have fixed columns and fixed precisions, so a
+/// specialized formatter working on the scaled integer value can replace
+/// the general purpose (and much slower) floating point formatting in fmt.
+static void append_fixed(fmt::memory_buffer& buffer, double value, size_t width, unsigned precision) {
+    static constexpr double SCALES[] = {1e0, 1e1, 1e2, 1e3, 1e4};
+    assert(precision < sizeof(SCALES) / sizeof(SCALES[0]));
+    auto t = value * SCALES[precision];
+    if (!(std::fabs(t) < 9e15) ||
+        std::fabs(t - (std::floor(t) + 0.5)) <= 8e-15 * std::fabs(t)) {
+        // Values outside the exact integer range -- in practice only NaN,
+        // which slips through check_values_size -- and scaled values
+        // sitting within a few ulps of a rounding tie, where the error
+        // introduced by the multiplication above could flip the rounding
+        // direction, go through snprintf, so that the output matches the
+        // previous fmt-based implementation.
+        char tmp[32];
+        auto length = snprintf(
+            tmp, sizeof(tmp), "%*.*f",
+            static_cast<int>(width), static_cast<int>(precision), value
+        );
+        buffer.append(tmp, tmp + length);
+        return;
+    }
+    // check_values_size already ensured that the scaled value fits in the
+    // 64-bit integer range
+    auto scaled = std::llround(t);
+    // small negative values round to a zero integer part, but still get a
+    // minus sign, as they do with printf %f
+    bool negative = std::signbit(value);
+    auto digits = static_cast<unsigned long long>(scaled < 0 ? -scaled : scaled);
+
+    char tmp[32];
+    char* cursor = tmp + sizeof(tmp);
+    for (unsigned i = 0; i < precision; i++) {
+        *--cursor = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    }
+    *--cursor = '.';
+    do {
+        *--cursor = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    } while (digits != 0);
+    if (negative) {
+        *--cursor = '-';
+    }
+
+    auto length = static_cast<size_t>(tmp + sizeof(tmp) - cursor);
+    for (size_t i = length; i < width; i++) {
+        buffer.push_back(' ');
+    }
+    buffer.append(cursor, tmp + sizeof(tmp));
+}
+
+static const char* to_gro_index(uint64_t i, char (&buffer)[8]) {
     if (i >= 99999) {
         if (i == 99999) {
             // Only warn once for this
@@ -153,13 +376,16 @@ static std::string to_gro_index(uint64_t i) {
         }
         return "*****";
     } else {
-        return std::to_string(i + 1);
+        return format_index(i + 1, buffer);
     }
 }
 
 void GROFormat::write_next(const Frame& frame) {
-    fmt::print(*file_, "{}\n", frame.get<Property::STRING>("name").value_or("GRO File produced by chemfiles"));
-    fmt::print(*file_, "{: >5d}\n", frame.size());
+    // Format the whole frame in memory first, then write it to the file in
+    // a single operation instead of one write per line
+    auto buffer = fmt::memory_buffer();
+    fmt::format_to(buffer, "{}\n", frame.get<Property::STRING>("name").value_or("GRO File produced by chemfiles"));
+    fmt::format_to(buffer, "{: >5d}\n", frame.size());
 
     // Only use numbers bigger than the biggest residue id as "resSeq" for
     // atoms without associated residue, and start generated residue id at
@@ -174,8 +400,10 @@ void GROFormat::write_next(const Frame& frame) {
 
     auto& positions = frame.positions();
     for (size_t i = 0; i < frame.size(); i++) {
+        char resid_buffer[8];
+        char index_buffer[8];
         std::string resname = "XXXXX";
-        std::string resid = "-1";
+        const char* resid = "-1";
         auto residue = frame.topology().residue_for_atom(i);
         if (residue) {
             resname = residue->name();
@@ -191,7 +419,7 @@ void GROFormat::write_next(const Frame& frame) {
         if (residue && residue->id()) {
             auto value = residue->id().value();
             if (value <= 99999) {
-                resid = std::to_string(value);
+                resid = format_index(value, resid_buffer);
             } else {
                 warning("GRO writer", "too many residues, removing residue id");
             }
@@ -199,7 +427,7 @@ void GROFormat::write_next(const Frame& frame) {
             // We need to manually assign a residue ID
             auto value = max_resid++;
             if (value <= 99999) {
-                resid = std::to_string(value);
+                resid = format_index(value, resid_buffer);
             }
         }
 
@@ -207,21 +435,24 @@ void GROFormat::write_next(const Frame& frame) {
         auto pos = positions[i] / 10;
         check_values_size(pos, 8, "atomic position");
 
+        auto& name = frame[i].name();
+        auto index = to_gro_index(i, index_buffer);
+        append_right(buffer, resid, std::strlen(resid), 5);
+        append_left(buffer, resname, 5);
+        append_right(buffer, name.c_str(), name.length(), 5);
+        append_right(buffer, index, std::strlen(index), 5);
+        append_fixed(buffer, pos[0], 8, 3);
+        append_fixed(buffer, pos[1], 8, 3);
+        append_fixed(buffer, pos[2], 8, 3);
+
         if (frame.velocities()) {
             auto vel = (*frame.velocities())[i] / 10;
             check_values_size(vel, 8, "atomic velocity");
-            fmt::print(
-                *file_,
-                "{: >5}{: <5}{: >5}{: >5}{:8.3f}{:8.3f}{:8.3f}{:8.4f}{:8.4f}{:8.4f}\n",
-                resid, resname, frame[i].name(), to_gro_index(i), pos[0], pos[1], pos[2], vel[0], vel[1], vel[2]
-            );
-        } else {
-            fmt::print(
-                *file_,
-                "{: >5}{: <5}{: >5}{: >5}{:8.3f}{:8.3f}{:8.3f}\n",
-                resid, resname, frame[i].name(), to_gro_index(i), pos[0], pos[1], pos[2]
-            );
+            append_fixed(buffer, vel[0], 8, 4);
+            append_fixed(buffer, vel[1], 8, 4);
+            append_fixed(buffer, vel[2], 8, 4);
         }
+        buffer.push_back('\n');
     }
 
     auto& cell = frame.cell();
@@ -230,8 +461,8 @@ void GROFormat::write_next(const Frame& frame) {
     // This means we cannot support incredibly large cell sizes, but these are likely not practical anyway
     if (cell.shape() == UnitCell::ORTHORHOMBIC || cell.shape() == UnitCell::INFINITE) {
         check_values_size(Vector3D(cell.a() / 10, cell.b() / 10, cell.c() / 10), 8, "Unit Cell");
-        fmt::print(
-            *file_,
+        fmt::format_to(
+            buffer,
             // Will print zeros if infinite, line is still required
             "  {:8.5f}  {:8.5f}  {:8.5f}\n",
             cell.a() / 10, cell.b() / 10, cell.c() / 10);
@@ -239,17 +470,26 @@ void GROFormat::write_next(const Frame& frame) {
         const auto& matrix = cell.matrix() / 10;
         check_values_size(Vector3D(matrix[0][0], matrix[1][1], matrix[2][2]), 8, "Unit Cell");
         check_values_size(Vector3D(matrix[0][1], matrix[0][2], matrix[1][2]), 8, "Unit Cell");
-        fmt::print(
-            *file_,
+        fmt::format_to(
+            buffer,
             "  {:8.5f}  {:8.5f}  {:8.5f} 0.0 0.0  {:8.5f} 0.0  {:8.5f}  {:8.5f}\n",
             matrix[0][0], matrix[1][1], matrix[2][2], matrix[0][1], matrix[0][2], matrix[1][2]
         );
     }
+
+    file_->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 }
 
 void check_values_size(const Vector3D& values, unsigned width, const std::string& context) {
-    double max_pos = std::pow(10.0, width) - 1;
-    double max_neg = -std::pow(10.0, width - 1) + 1;
+    // Powers of ten up to the biggest field width used in this format. This
+    // function runs for every atom when writing, and std::pow is a full
+    // libm call for what is a small-integer exponent.
+    static constexpr double POW10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+    };
+    assert(width >= 1 && width < sizeof(POW10) / sizeof(POW10[0]));
+    double max_pos = POW10[width] - 1;
+    double max_neg = -POW10[width - 1] + 1;
     if (values[0] > max_pos || values[1] > max_pos || values[2] > max_pos ||
         values[0] < max_neg || values[1] < max_neg || values[2] < max_neg) {
         throw format_error(
@@ -258,7 +498,7 @@ void check_values_size(const Vector3D& values, unsigned width, const std::string
     }
 }
 
-std::streampos GROFormat::forward() {
+StepPosition GROFormat::forward() {
     if (!*file_) {
         return std::streampos(-1);
     }
@@ -285,5 +525,47 @@ std::streampos GROFormat::forward() {
             "not enough lines in '{}' for GRO format", file_->path()
         );
     }
-    return position;
+    return {position, natoms};
+}
+
+/// Check whether the line starting at `it` contains a single positive
+/// integer, like the atom count line of a frame. On success, `next` is set
+/// to the start of the following line, or to `end` for the last line of the
+/// data; it is meaningless when the function returns `false`.
+static bool is_atom_count_line(const char* it, const char* end, const char*& next) {
+    while (it < end && (*it == ' ' || *it == '\t')) {
+        it++;
+    }
+    size_t digits = 0;
+    while (it < end && *it >= '0' && *it <= '9') {
+        it++;
+        digits++;
+    }
+    while (it < end && (*it == ' ' || *it == '\t' || *it == '\r')) {
+        it++;
+    }
+    next = (it < end) ? it + 1 : end;
+    return digits != 0 && (it == end || *it == '\n');
+}
+
+bool GROFormat::can_split_at(const char* data, size_t length) const {
+    // A GRO frame starts with a free-form comment line, followed by the
+    // number of atoms on its own line. Check that the line after `data`
+    // contains a single positive integer, but that the line after that one
+    // does not: an actual atom count is always followed by an atom or box
+    // line. Without the second check, a comment line which is itself a bare
+    // integer would make the preceding box line pass as a frame start.
+    auto end = data + length;
+    auto eol = static_cast<const char*>(std::memchr(data, '\n', length));
+    if (eol == nullptr) {
+        return false;
+    }
+
+    const char* after_count = nullptr;
+    if (!is_atom_count_line(eol + 1, end, after_count)) {
+        return false;
+    }
+
+    const char* ignored = nullptr;
+    return !is_atom_count_line(after_count, end, ignored);
 }
@@ -1,12 +1,13 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
-#include <cstdio>
-#include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
 
 #include <tuple>
-#include <array>
+#include <utility>
 #include <string>
 #include <vector>
 #include <memory>
@@ -55,191 +56,295 @@ template<> FormatInfo chemfiles::format_information<LAMMPSDataFormat>() {
 }
 
 atom_style::atom_style(const std::string& name): name_(name) {
-    if (name == "angle") {
-        style_ = ANGLE;
-        expected_ = 6;
-    } else if (name == "atomic") {
-        style_ = ATOMIC;
-        expected_ = 5;
-    } else if (name == "body") {
-        style_ = BODY;
-        expected_ = 6;
-    } else if (name == "bond") {
-        style_ = BOND;
-        expected_ = 6;
-    } else if (name == "charge") {
-        style_ = CHARGE;
-        expected_ = 6;
-    } else if (name == "dipole") {
-        style_ = DIPOLE;
-        expected_ = 6;
-    } else if (name == "dpd") {
-        style_ = DPD;
-        expected_ = 5;
-    } else if (name == "electron") {
-        style_ = ELECTRON;
-        expected_ = 5;
-    } else if (name == "ellipsoid") {
-        style_ = ELLIPSOID;
-        expected_ = 5;
-    } else if (name == "full") {
-        style_ = FULL;
-        expected_ = 7;
-    } else if (name == "line") {
-        style_ = LINE;
-        expected_ = 6;
-    } else if (name == "meso") {
-        style_ = MESO;
-        expected_ = 5;
-    } else if (name == "molecular") {
-        style_ = MOLECULAR;
-        expected_ = 6;
-    } else if (name == "peri") {
-        style_ = PERI;
-        expected_ = 5;
-    } else if (name == "smd") {
-        style_ = SMD;
-        expected_ = 7;
-    } else if (name == "sphere") {
-        style_ = SPHERE;
-        expected_ = 5;
-    } else if (name == "template") {
-        style_ = TEMPLATE;
-        expected_ = 6;
-    } else if (name == "tri") {
-        style_ = TRI;
-        expected_ = 6;
-    } else if (name == "wavepacket") {
-        style_ = WAVEPACKET;
-        expected_ = 6;
-    } else if (name == "hybrid") {
-        style_ = HYBRID;
-        expected_ = 5;
-    } else {
+    struct style_entry {
+        const char* name;
+        decltype(style_) style;
+        int expected;
+    };
+    // List of known styles with the number of expected data, sorted by
+    // name so that the lookup can use a binary search
+    static const style_entry STYLES[] = {
+        {"angle", ANGLE, 6},
+        {"atomic", ATOMIC, 5},
+        {"body", BODY, 6},
+        {"bond", BOND, 6},
+        {"charge", CHARGE, 6},
+        {"dipole", DIPOLE, 6},
+        {"dpd", DPD, 5},
+        {"electron", ELECTRON, 5},
+        {"ellipsoid", ELLIPSOID, 5},
+        {"full", FULL, 7},
+        {"hybrid", HYBRID, 5},
+        {"line", LINE, 6},
+        {"meso", MESO, 5},
+        {"molecular", MOLECULAR, 6},
+        {"peri", PERI, 5},
+        {"smd", SMD, 7},
+        {"sphere", SPHERE, 5},
+        {"template", TEMPLATE, 6},
+        {"tri", TRI, 6},
+        {"wavepacket", WAVEPACKET, 6},
+    };
+
+    auto it = std::lower_bound(std::begin(STYLES), std::end(STYLES), name,
+        [](const style_entry& entry, const std::string& value) {
+            return std::strcmp(entry.name, value.c_str()) < 0;
+        }
+    );
+    if (it == std::end(STYLES) || name != it->name) {
         throw format_error("unknown atom style '{}'", name);
     }
+    style_ = it->style;
+    expected_ = it->expected;
     assert(expected_ != 0);
 }
 
+/// Cursor over the fields of an atom line. Parsing one field at a time
+/// with strtoull/strtod is much faster than sscanf, which re-interprets
+/// its format string for every line.
+struct field_cursor {
+    const char* position;
+
+    /// Try to parse an integer field, advancing past it on success. The
+    /// field must be a positive integer followed by whitespace or the end
+    /// of the line.
+    bool integer(size_t& value) {
+        auto it = position;
+        while (*it == ' ' || *it == '\t') {
+            it++;
+        }
+        // strtoull silently wraps negative values around instead of failing
+        if (*it == '-') {
+            return false;
+        }
+        char* end = nullptr;
+        auto parsed = std::strtoull(it, &end, 10);
+        if (end == it || (*end != '\0' && *end != ' ' && *end != '\t' && *end != '\r')) {
+            return false;
+        }
+        position = end;
+        value = static_cast<size_t>(parsed);
+        return true;
+    }
+
+    /// Try to parse a floating point field, advancing past it on success
+    bool real(double& value) {
+        char* end = nullptr;
+        auto parsed = std::strtod(position, &end);
+        if (end == position) {
+            return false;
+        }
+        position = end;
+        value = parsed;
+        return true;
+    }
+
+    /// Get the next field as a string, returning an empty string if there
+    /// is no field left
+    std::string token() {
+        while (*position == ' ' || *position == '\t') {
+            position++;
+        }
+        auto start = position;
+        while (*position != '\0' && *position != ' ' && *position != '\t' && *position != '\r') {
+            position++;
+        }
+        return std::string(start, position);
+    }
+
+    /// Check whether only whitespace remains until the end of the line
+    bool at_end() const {
+        auto it = position;
+        while (*it == ' ' || *it == '\t' || *it == '\r') {
+            it++;
+        }
+        return *it == '\0';
+    }
+};
+
 atom_data atom_style::read_line(const std::string& line, size_t index) const {
     atom_data data;
     int assigned = 0;
+    auto cursor = field_cursor{line.c_str()};
+    // values for the fields that are skipped, mirroring the `%*d`/`%*f`
+    // behavior of the previous sscanf-based implementation
+    size_t skipped_integer = 0;
+    double skipped_real = 0;
     switch (style_) {
     case ANGLE:
     case BOND:
     case MOLECULAR:
         // atom-ID molecule-ID atom-type x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %zu %lf %lf %lf",
-            &data.index, &data.molid, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.molid);
+        assigned += cursor.integer(data.type);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case ATOMIC:
         // atom-ID atom-type x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %lf %lf %lf",
-            &data.index, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case BODY:
         // atom-ID atom-type bodyflag mass x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %*d %lf %lf %lf %lf",
-            &data.index, &data.type, &data.mass, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        cursor.integer(skipped_integer);
+        assigned += cursor.real(data.mass);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
+        data.has_mass = true;
         break;
     case CHARGE:
     case DIPOLE:
         // atom-ID atom-type q x y z
         // atom-ID atom-type q x y z mux muy muz
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %lf %lf %lf %lf",
-            &data.index, &data.type, &data.charge, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        assigned += cursor.real(data.charge);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
+        data.has_charge = true;
         break;
     case DPD:
         // atom-ID atom-type theta x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %*f %lf %lf %lf",
-            &data.index, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case ELECTRON:
         // atom-ID atom-type q spin eradius x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %*f %*f %lf %lf %lf",
-            &data.index, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        cursor.real(skipped_real);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case ELLIPSOID:
         // atom-ID atom-type ellipsoidflag density x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %*d %*f %lf %lf %lf",
-            &data.index, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        cursor.integer(skipped_integer);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case FULL:
         // atom-ID molecule-ID atom-type q x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %zu %lf %lf %lf %lf",
-            &data.index, &data.molid, &data.type, &data.charge, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.molid);
+        assigned += cursor.integer(data.type);
+        assigned += cursor.real(data.charge);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
+        data.has_charge = true;
         break;
     case LINE:
         // atom-ID molecule-ID atom-type lineflag density x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %zu %*d %*f %lf %lf %lf",
-            &data.index, &data.molid, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.molid);
+        assigned += cursor.integer(data.type);
+        cursor.integer(skipped_integer);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case MESO:
         // atom-ID atom-type rho e cv x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %*f %*f %*f %lf %lf %lf",
-            &data.index, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        cursor.real(skipped_real);
+        cursor.real(skipped_real);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case PERI:
         // atom-ID atom-type volume density x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %*f %*f %lf %lf %lf",
-            &data.index, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        cursor.real(skipped_real);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case SMD:
         // atom-ID atom-type molecule volume mass kernel-radius contact-radius x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %zu %*f %lf %*f %*f %lf %lf %lf",
-            &data.index, &data.type, &data.molid, &data.mass, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        assigned += cursor.integer(data.molid);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.mass);
+        cursor.real(skipped_real);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
+        data.has_mass = true;
         break;
     case SPHERE:
         // atom-ID atom-type diameter density x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %*f %*f %lf %lf %lf",
-            &data.index, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        cursor.real(skipped_real);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case TEMPLATE:
         // atom-ID molecule-ID template-index template-atom atom-type x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %*d %*d %zu %lf %lf %lf",
-            &data.index, &data.molid, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.molid);
+        cursor.integer(skipped_integer);
+        cursor.integer(skipped_integer);
+        assigned += cursor.integer(data.type);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case TRI:
         // atom-ID molecule-ID atom-type triangleflag density x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %zu %*d %*f %lf %lf %lf",
-            &data.index, &data.molid, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.molid);
+        assigned += cursor.integer(data.type);
+        cursor.integer(skipped_integer);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     case WAVEPACKET:
         // atom-ID atom-type charge spin eradius etag cs_re cs_im x y z
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %lf %*f %*f %*d %*f %*f %lf %lf %lf",
-            &data.index, &data.type, &data.charge, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        assigned += cursor.real(data.charge);
+        cursor.real(skipped_real);
+        cursor.real(skipped_real);
+        cursor.integer(skipped_integer);
+        cursor.real(skipped_real);
+        cursor.real(skipped_real);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
+        data.has_charge = true;
         break;
     case HYBRID:
         if (!warned_) {
@@ -247,10 +352,11 @@ atom_data atom_style::read_line(const std::string& line, size_t index) const {
             warned_ = true;
         }
         // atom-ID atom-type x y z sub-style1 sub-style2 ...
-        assigned = sscanf(
-            line.c_str(), "%zu %zu %lf %lf %lf",
-            &data.index, &data.type, &data.x, &data.y, &data.z
-        );
+        assigned += cursor.integer(data.index);
+        assigned += cursor.integer(data.type);
+        assigned += cursor.real(data.x);
+        assigned += cursor.real(data.y);
+        assigned += cursor.real(data.z);
         break;
     }
 
@@ -273,8 +379,22 @@ atom_data atom_style::read_line(const std::string& line, size_t index) const {
 /// Split a string in data (stays in the `line` parameter) and comment
 /// (in the return value).
 static std::string split_comment(std::string& line);
-/// Check if the line is an unused header value
-static bool is_unused_header(const std::string& line);
+
+/// Check whether the text at `keyword` is exactly `expected`, followed by
+/// nothing but whitespace
+static bool header_keyword_is(const char* keyword, const char* expected) {
+    while (*expected != '\0') {
+        if (*keyword != *expected) {
+            return false;
+        }
+        keyword++;
+        expected++;
+    }
+    while (*keyword == ' ' || *keyword == '\t' || *keyword == '\r') {
+        keyword++;
+    }
+    return *keyword == '\0';
+}
 
 LAMMPSDataFormat::LAMMPSDataFormat(std::string path, File::Mode mode, File::Compression compression):
     TextFormat(std::move(path), mode, compression),
@@ -292,8 +412,13 @@ void LAMMPSDataFormat::read_next(Frame& frame) {
     // VMD topotools writes the atom style in the comment header
     auto it = comment.find("atom_style");
     if (it != std::string::npos) {
-        auto end = trim(comment.substr(it + 10));
-        atom_style_name_ = trim(split(end, ' ')[0]);
+        // only the first word after "atom_style" is needed, extract it
+        // directly instead of going through trim + split
+        auto start = comment.find_first_not_of(" \t\r\n", it + 10);
+        if (start != std::string::npos) {
+            auto end = comment.find_first_of(" \t\r\n", start);
+            atom_style_name_ = comment.substr(start, end - start);
+        }
     }
 
     while(!file_->eof()) {
@@ -330,37 +455,116 @@ void LAMMPSDataFormat::read_header(Frame& frame) {
     auto matrix = Matrix3D::unit();
     auto shape = UnitCell::ORTHORHOMBIC;
 
+    // Reuse the same buffers for all the header lines instead of
+    // allocating fresh strings for every line
+    std::string line;
+    std::string content;
     while (!file_->eof()) {
-        auto line = file_->readline();
-        auto content = line;
+        file_->readline(line);
+        content = line;
         split_comment(content);
-        if (content.empty() || is_unused_header(content)) {
-            // Nothing to do
-        } else if (content.find("atoms") != std::string::npos) {
-            natoms_ = read_header_integer(content, "atoms");
-        } else if (content.find("bonds") != std::string::npos) {
-            nbonds_ = read_header_integer(content, "bonds");
-        } else if (content.find("atom types") != std::string::npos) {
-            natom_types_ = read_header_integer(content, "atom types");
-        } else if (content.find("xlo xhi") != std::string::npos) {
-            matrix[0][0] = read_header_box_bounds(content, "xlo xhi");
-        } else if (content.find("ylo yhi") != std::string::npos) {
-            matrix[1][1] = read_header_box_bounds(content, "ylo yhi");
-        } else if (content.find("zlo zhi") != std::string::npos) {
-            matrix[2][2] = read_header_box_bounds(content, "zlo zhi");
-        } else if (content.find("xy xz yz") != std::string::npos) {
-            auto splitted = split(trim(content), ' ');
-            if (splitted.size() != 6) {
-                throw format_error(
-                    "invalid header value: expected '<xy> <xz> <yz> xy xz yz', got '{}'", content
-                );
+        if (content.empty()) {
+            continue;
+        }
+
+        // Header lines are '<values> <keyword>': skip the numeric values,
+        // then dispatch on the first character of the keyword instead of
+        // searching the whole line for every known keyword
+        auto cursor = field_cursor{content.c_str()};
+        double skipped = 0;
+        while (cursor.real(skipped)) {}
+        auto keyword = cursor.position;
+        while (*keyword == ' ' || *keyword == '\t') {
+            keyword++;
+        }
+
+        bool handled = true;
+        switch (keyword[0]) {
+        case 'a':
+            if (header_keyword_is(keyword, "atoms")) {
+                natoms_ = read_header_integer(content, "atoms");
+            } else if (header_keyword_is(keyword, "atom types")) {
+                natom_types_ = read_header_integer(content, "atom types");
+            } else if (
+                header_keyword_is(keyword, "angles") ||
+                header_keyword_is(keyword, "angle types")) {
+                // Unused header value
+            } else {
+                handled = false;
+            }
+            break;
+        case 'b':
+            if (header_keyword_is(keyword, "bonds")) {
+                nbonds_ = read_header_integer(content, "bonds");
+            } else if (
+                header_keyword_is(keyword, "bond types") ||
+                header_keyword_is(keyword, "bodies")) {
+                // Unused header value
+            } else {
+                handled = false;
+            }
+            break;
+        case 'd':
+            handled = header_keyword_is(keyword, "dihedrals") ||
+                      header_keyword_is(keyword, "dihedral types");
+            break;
+        case 'e':
+            handled = header_keyword_is(keyword, "ellipsoids") ||
+                      header_keyword_is(keyword, "extra bond per atom") ||
+                      header_keyword_is(keyword, "extra angle per atom") ||
+                      header_keyword_is(keyword, "extra dihedral per atom") ||
+                      header_keyword_is(keyword, "extra improper per atom") ||
+                      header_keyword_is(keyword, "extra special per atom");
+            break;
+        case 'i':
+            handled = header_keyword_is(keyword, "impropers") ||
+                      header_keyword_is(keyword, "improper types");
+            break;
+        case 'l':
+            handled = header_keyword_is(keyword, "lines");
+            break;
+        case 't':
+            handled = header_keyword_is(keyword, "triangles");
+            break;
+        case 'x':
+            if (header_keyword_is(keyword, "xlo xhi")) {
+                matrix[0][0] = read_header_box_bounds(content, "xlo xhi");
+            } else if (header_keyword_is(keyword, "xy xz yz")) {
+                auto values = field_cursor{content.c_str()};
+                bool parsed = values.real(matrix[0][1]) &&
+                              values.real(matrix[0][2]) &&
+                              values.real(matrix[1][2]);
+                if (!parsed) {
+                    throw format_error(
+                        "invalid header value: expected '<xy> <xz> <yz> xy xz yz', got '{}'", content
+                    );
+                }
+                // Even if all parameters are 0, set shape to TRICLINIC
+                shape = UnitCell::TRICLINIC;
+            } else {
+                handled = false;
+            }
+            break;
+        case 'y':
+            if (header_keyword_is(keyword, "ylo yhi")) {
+                matrix[1][1] = read_header_box_bounds(content, "ylo yhi");
+            } else {
+                handled = false;
+            }
+            break;
+        case 'z':
+            if (header_keyword_is(keyword, "zlo zhi")) {
+                matrix[2][2] = read_header_box_bounds(content, "zlo zhi");
+            } else {
+                handled = false;
             }
-            matrix[0][1] = parse<double>(splitted[0]);
-            matrix[0][2] = parse<double>(splitted[1]);
-            matrix[1][2] = parse<double>(splitted[2]);
-            // Even if all parameters are 0, set shape to TRICLINIC
-            shape = UnitCell::TRICLINIC;
-        } else {
+            break;
+        default:
+            handled = false;
+            break;
+        }
+
+        if (!handled) {
             // End of the header, get the section and break
             current_section_ = get_section(line);
             break;
@@ -372,30 +576,32 @@ void LAMMPSDataFormat::read_header(Frame& frame) {
 }
 
 size_t LAMMPSDataFormat::read_header_integer(const std::string& line, const std::string& context) {
-    auto splitted = split(trim(line), ' ');
-    if (splitted.size() < 2) {
+    auto cursor = field_cursor{line.c_str()};
+    size_t value = 0;
+    if (!cursor.integer(value) || cursor.at_end()) {
         throw format_error(
             "invalid header value: expected '<n> {}', got '{}'", context, line
         );
     }
-    return parse<size_t>(splitted[0]);
+    return value;
 }
 
 double LAMMPSDataFormat::read_header_box_bounds(const std::string& line, const std::string& context) {
-    auto splitted = split(trim(line), ' ');
-    if (splitted.size() < 4) {
+    auto cursor = field_cursor{line.c_str()};
+    double low = 0;
+    double high = 0;
+    if (!cursor.real(low) || !cursor.real(high) || cursor.at_end()) {
         throw format_error(
             "invalid header value: expected '<lo> <hi> {}', got '{}'", context, line
         );
     }
-    auto low = parse<double>(splitted[0]);
-    auto high = parse<double>(splitted[1]);
     return high - low;
 }
 
 void LAMMPSDataFormat::get_next_section() {
+    std::string line;
     while (!file_->eof()) {
-        auto line = file_->readline();
+        file_->readline(line);
         if (!line.empty()) {
             auto section = get_section(line);
             if (section == NOT_A_SECTION) {
@@ -409,8 +615,9 @@ void LAMMPSDataFormat::get_next_section() {
 }
 
 void LAMMPSDataFormat::skip_to_next_section() {
+    std::string line;
     while (!file_->eof()) {
-        auto line = file_->readline();
+        file_->readline(line);
         if (!line.empty()) {
             auto section = get_section(line);
             if (section == NOT_A_SECTION) {
@@ -436,12 +643,26 @@ void LAMMPSDataFormat::read_atoms(Frame& frame) {
     style_ = atom_style(atom_style_name_);
 
     frame.resize(natoms_);
-    auto positions = frame.positions();
-    auto residues = std::unordered_map<size_t, Residue>();
+    // Accumulate the parsed coordinates in one contiguous buffer per
+    // coordinate, and copy them into the frame positions in a single
+    // pass once all the atoms are read. The 1-wide buffers are friendlier
+    // to the cache than scattered writes into 3-wide Vector3D, and the
+    // final copy loop is a vectorizable linear scan.
+    auto xs = std::vector<double>(natoms_);
+    auto ys = std::vector<double>(natoms_);
+    auto zs = std::vector<double>(natoms_);
+    // list of residues sorted by molecule id: successive atoms usually
+    // belong to the same molecule, so a flat sorted vector with a fast
+    // path on the last residue beats a hash map probe per atom
+    auto residues = std::vector<std::pair<size_t, Residue>>();
+    // cache of the string form of the atomic types: there is usually only
+    // a handful of types, no need to call std::to_string for every atom
+    auto type_names = std::vector<std::string>();
 
     size_t n = 0;
+    std::string line;
     while (n < natoms_ && !file_->eof()) {
-        auto line = file_->readline();
+        file_->readline(line);
         auto comment = split_comment(line);
         if (line.empty()) {continue;}
 
@@ -455,40 +676,67 @@ void LAMMPSDataFormat::read_atoms(Frame& frame) {
 
         if (!comment.empty()) {
             // Read the first string after the comment, and use it as atom name
-            auto name = split(trim(comment), ' ')[0];
-            if (names_.empty()) {
-                names_.resize(natoms_);
+            auto name = field_cursor{comment.c_str()}.token();
+            if (!name.empty()) {
+                names_.emplace_back(data.index, std::move(name));
             }
-            names_[data.index] = name;
         }
 
-        auto atom = Atom(std::to_string(data.type));
-        if (!std::isnan(data.charge)) {
+        if (data.type >= type_names.size()) {
+            type_names.resize(data.type + 1);
+        }
+        if (type_names[data.type].empty()) {
+            type_names[data.type] = std::to_string(data.type);
+        }
+
+        auto atom = Atom(type_names[data.type]);
+        if (data.has_charge) {
             atom.set_charge(data.charge);
         }
-        if (!std::isnan(data.mass)) {
+        if (data.has_mass) {
             atom.set_mass(data.mass);
         }
 
         if (data.molid != 0) {
-            auto residue_iter = residues.find(data.molid);
-            if (residue_iter != residues.end()) {
-                residue_iter->second.add_atom(data.index);
-            } else {
+            if (!residues.empty() && residues.back().first == data.molid) {
+                residues.back().second.add_atom(data.index);
+            } else if (residues.empty() || data.molid > residues.back().first) {
                 auto residue = Residue("", data.molid);
                 residue.add_atom(data.index);
-                residues.emplace(data.molid, std::move(residue));
+                residues.emplace_back(data.molid, std::move(residue));
+            } else {
+                // Out of order molecule id, find where it belongs to keep
+                // the list sorted
+                auto residue_iter = std::lower_bound(residues.begin(), residues.end(), data.molid,
+                    [](const std::pair<size_t, Residue>& entry, size_t id) {
+                        return entry.first < id;
+                    }
+                );
+                if (residue_iter != residues.end() && residue_iter->first == data.molid) {
+                    residue_iter->second.add_atom(data.index);
+                } else {
+                    auto residue = Residue("", data.molid);
+                    residue.add_atom(data.index);
+                    residues.insert(residue_iter, {data.molid, std::move(residue)});
+                }
             }
         }
 
         frame[data.index] = atom;
-        positions[data.index][0] = data.x;
-        positions[data.index][1] = data.y;
-        positions[data.index][2] = data.z;
+        xs[data.index] = data.x;
+        ys[data.index] = data.y;
+        zs[data.index] = data.z;
         n++;
     }
 
-    for (auto it: std::move(residues)) {
+    auto positions = frame.positions();
+    for (size_t i=0; i<natoms_; i++) {
+        positions[i][0] = xs[i];
+        positions[i][1] = ys[i];
+        positions[i][2] = zs[i];
+    }
+
+    for (auto& it: residues) {
         frame.add_residue(std::move(it.second));
     }
 
@@ -501,18 +749,18 @@ void LAMMPSDataFormat::read_masses() {
         throw format_error("missing atom types count in header");
     }
     size_t n = 0;
+    std::string line;
     while (n < natom_types_ && !file_->eof()) {
-        auto line = file_->readline();
+        file_->readline(line);
         split_comment(line);
         if (line.empty()) {continue;}
 
-        auto splitted = split(trim(line), ' ');
-        if (splitted.size() != 2) {
+        auto cursor = field_cursor{line.c_str()};
+        auto type = cursor.token();
+        double mass = 0;
+        if (type.empty() || !cursor.real(mass) || !cursor.at_end()) {
             throw format_error("bad mass specification '{}'", line);
         }
-
-        auto type = splitted[0];
-        auto mass = parse<double>(splitted[1]);
         masses_.emplace(std::move(type), mass);
         n++;
     }
@@ -525,20 +773,32 @@ void LAMMPSDataFormat::read_bonds(Frame& frame) {
     if (nbonds_ == 0) {
         throw format_error("missing bonds count in header");
     }
+    // Collect all the bonds first and add them to the frame in sorted
+    // order: adding a bond does a sorted insert in the topology, and
+    // inserting in order always appends at the end instead of shifting
+    // the bonds already there.
+    auto bonds = std::vector<std::pair<size_t, size_t>>();
+    bonds.reserve(nbonds_);
+
     size_t n = 0;
+    std::string line;
     while (n < nbonds_ && !file_->eof()) {
-        auto line = file_->readline();
+        file_->readline(line);
         split_comment(line);
         if (line.empty()) {continue;}
 
-        auto splitted = split(trim(line), ' ');
-        if (splitted.size() != 4) {
+        auto cursor = field_cursor{line.c_str()};
+        size_t bond_id = 0;
+        size_t bond_type = 0;
+        size_t i = 0;
+        size_t j = 0;
+        bool parsed = cursor.integer(bond_id) && cursor.integer(bond_type) &&
+                      cursor.integer(i) && cursor.integer(j) && cursor.at_end();
+        if (!parsed) {
             throw format_error("bad bond specification '{}'", line);
         }
         // LAMMPS use 1-based indexing
-        auto i = parse<size_t>(splitted[2]) - 1;
-        auto j = parse<size_t>(splitted[3]) - 1;
-        frame.add_bond(i, j);
+        bonds.emplace_back(std::min(i, j) - 1, std::max(i, j) - 1);
         n++;
     }
 
@@ -546,6 +806,11 @@ void LAMMPSDataFormat::read_bonds(Frame& frame) {
         throw format_error("end of file found before getting all bonds");
     }
 
+    std::sort(bonds.begin(), bonds.end());
+    for (auto& bond: bonds) {
+        frame.add_bond(bond.first, bond.second);
+    }
+
     get_next_section();
 }
 
@@ -555,23 +820,26 @@ void LAMMPSDataFormat::read_velocities(Frame& frame) {
         throw format_error("missing atoms count in header");
     }
     size_t n = 0;
+    std::string line;
     frame.add_velocities();
     auto velocities = *frame.velocities();
     while (n < natoms_ && !file_->eof()) {
-        auto line = file_->readline();
+        file_->readline(line);
         split_comment(line);
         if (line.empty()) {continue;}
 
-        auto splitted = split(trim(line), ' ');
-        if (splitted.size() < 4) {
+        auto cursor = field_cursor{line.c_str()};
+        size_t id = 0;
+        double vx = 0;
+        double vy = 0;
+        double vz = 0;
+        bool parsed = cursor.integer(id) && cursor.real(vx) &&
+                      cursor.real(vy) && cursor.real(vz);
+        if (!parsed) {
             throw format_error("bad velocity specification '{}'", line);
         }
         // LAMMPS use 1-based indexing
-        auto id = parse<size_t>(splitted[0]) - 1;
-        auto vx = parse<double>(splitted[1]);
-        auto vy = parse<double>(splitted[2]);
-        auto vz = parse<double>(splitted[3]);
-        velocities[id] = Vector3D(vx, vy, vz);
+        velocities[id - 1] = Vector3D(vx, vy, vz);
         n++;
     }
 
@@ -594,14 +862,10 @@ void LAMMPSDataFormat::setup_masses(Frame& frame) const {
 }
 
 void LAMMPSDataFormat::setup_names(Frame& frame) const {
-    if (names_.empty()) {return;}
-    assert(names_.size() == frame.size());
-
-    for (size_t i=0; i<frame.size(); i++) {
-        if (!names_[i].empty()) {
-            frame[i].set_name(names_[i]);
-            frame[i].set_type(names_[i]);
-        }
+    for (auto& it: names_) {
+        assert(it.first < frame.size());
+        frame[it.first].set_name(it.second);
+        frame[it.first].set_type(it.second);
     }
 }
 
@@ -662,15 +926,14 @@ static angle_type normalize_angle_type(size_t i, size_t j, size_t k) {
 }
 
 static dihedral_type normalize_dihedral_type(size_t i, size_t j, size_t k, size_t m) {
+    // Compare the (max, min) of both ends without nested branching: the
+    // comparisons below all compile down to conditional moves
     auto max_ij = std::max(i, j);
     auto max_km = std::max(k, m);
-    if (max_ij == max_km) {
-        if (std::min(i, j) < std::min(k, m)) {
-            return std::make_tuple(i, j, k, m);
-        } else {
-            return std::make_tuple(m, k, j, i);
-        }
-    } else if (max_ij < max_km) {
+    auto min_ij = std::min(i, j);
+    auto min_km = std::min(k, m);
+    bool forward = max_ij < max_km || (max_ij == max_km && min_ij < min_km);
+    if (forward) {
         return std::make_tuple(i, j, k, m);
     } else {
         return std::make_tuple(m, k, j, i);
@@ -678,11 +941,11 @@ static dihedral_type normalize_dihedral_type(size_t i, size_t j, size_t k, size_
 }
 
 static improper_type normalize_improper_type(size_t i, size_t j, size_t k, size_t m) {
-    std::array<size_t, 3> others = {{i, k, m}};
-    std::sort(others.begin(), others.end());
-    i = others[0];
-    k = others[1];
-    m = others[2];
+    // sorting network for the three outer atoms, cheaper than std::sort
+    // on exactly three values
+    if (i > k) {std::swap(i, k);}
+    if (k > m) {std::swap(k, m);}
+    if (i > k) {std::swap(i, k);}
     return std::make_tuple(i, j, k, m);
 }
 
@@ -690,81 +953,148 @@ static atom_type make_atom_type(const Atom& atom) {
     return {atom.type(), atom.mass()};
 }
 
+static size_t hash_combine(size_t hash, size_t value) {
+    // Boost-style hash combination
+    return hash ^ (value + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+size_t type_hasher::operator()(const atom_type& type) const {
+    return hash_combine(
+        std::hash<std::string>()(type.first),
+        std::hash<double>()(type.second)
+    );
+}
+
+size_t type_hasher::operator()(const bond_type& type) const {
+    return hash_combine(std::get<0>(type), std::get<1>(type));
+}
+
+size_t type_hasher::operator()(const angle_type& type) const {
+    return hash_combine(
+        hash_combine(std::get<0>(type), std::get<1>(type)),
+        std::get<2>(type)
+    );
+}
+
+size_t type_hasher::operator()(const dihedral_type& type) const {
+    return hash_combine(
+        hash_combine(
+            hash_combine(std::get<0>(type), std::get<1>(type)),
+            std::get<2>(type)
+        ),
+        std::get<3>(type)
+    );
+}
+
+/// Fill `index` with the position of each value of `set` in the sorted
+/// vector backing it
+template<class T>
+static void fill_type_index(const sorted_set<T>& set, std::unordered_map<T, size_t, type_hasher>& index) {
+    index.reserve(set.size());
+    for (size_t i=0; i<set.size(); i++) {
+        index.emplace(set[i], i);
+    }
+}
+
 DataTypes::DataTypes(const Topology& topology) {
+    // Upper bound on the number of types: there are usually far fewer
+    // types than elements, but reserving the element count makes sure the
+    // insertion loops below never reallocate
+    atoms_.reserve(topology.size());
+    bonds_.reserve(topology.bonds().size());
+    angles_.reserve(topology.angles().size());
+    dihedrals_.reserve(topology.dihedrals().size());
+    impropers_.reserve(topology.impropers().size());
+
     for (auto& atom: topology) {
         atoms_.insert(make_atom_type(atom));
     }
+    // the atom types index is used by `atom_type_id` just below
+    fill_type_index(atoms_, atoms_index_);
+
+    // Resolve the type id of every atom once, instead of hashing the same
+    // atom type again for each bond/angle/dihedral/improper it is part of.
+    // The ids are kept around for the writing code to reuse.
+    atom_type_ids_.resize(topology.size());
+    for (size_t i=0; i<topology.size(); i++) {
+        atom_type_ids_[i] = atom_type_id(topology[i]);
+    }
 
     for (auto& bond: topology.bonds()) {
-        auto i = atom_type_id(topology[bond[0]]);
-        auto j = atom_type_id(topology[bond[1]]);
+        auto i = atom_type_ids_[bond[0]];
+        auto j = atom_type_ids_[bond[1]];
         bonds_.insert(normalize_bond_type(i, j));
     }
 
     for (auto& angle: topology.angles()) {
-        auto i = atom_type_id(topology[angle[0]]);
-        auto j = atom_type_id(topology[angle[1]]);
-        auto k = atom_type_id(topology[angle[2]]);
+        auto i = atom_type_ids_[angle[0]];
+        auto j = atom_type_ids_[angle[1]];
+        auto k = atom_type_ids_[angle[2]];
         angles_.insert(normalize_angle_type(i, j, k));
     }
 
     for (auto& dihedral: topology.dihedrals()) {
-        auto i = atom_type_id(topology[dihedral[0]]);
-        auto j = atom_type_id(topology[dihedral[1]]);
-        auto k = atom_type_id(topology[dihedral[2]]);
-        auto m = atom_type_id(topology[dihedral[3]]);
+        auto i = atom_type_ids_[dihedral[0]];
+        auto j = atom_type_ids_[dihedral[1]];
+        auto k = atom_type_ids_[dihedral[2]];
+        auto m = atom_type_ids_[dihedral[3]];
         dihedrals_.insert(normalize_dihedral_type(i, j, k, m));
     }
 
     for (auto& improper: topology.impropers()) {
-        auto i = atom_type_id(topology[improper[0]]);
-        auto j = atom_type_id(topology[improper[1]]);
-        auto k = atom_type_id(topology[improper[2]]);
-        auto m = atom_type_id(topology[improper[3]]);
+        auto i = atom_type_ids_[improper[0]];
+        auto j = atom_type_ids_[improper[1]];
+        auto k = atom_type_ids_[improper[2]];
+        auto m = atom_type_ids_[improper[3]];
         impropers_.insert(normalize_improper_type(i, j, k, m));
     }
+
+    fill_type_index(bonds_, bonds_index_);
+    fill_type_index(angles_, angles_index_);
+    fill_type_index(dihedrals_, dihedrals_index_);
+    fill_type_index(impropers_, impropers_index_);
 }
 
 size_t DataTypes::atom_type_id(const Atom& atom) const {
-    auto it = atoms_.find(make_atom_type(atom));
-    if (it != atoms_.end()) {
-        return static_cast<size_t>(it - atoms_.begin());
+    auto it = atoms_index_.find(make_atom_type(atom));
+    if (it != atoms_index_.end()) {
+        return it->second;
     } else {
         throw error("invalid atom type passed to atom_type_id, this is a bug");
     }
 }
 
 size_t DataTypes::bond_type_id(size_t type_i, size_t type_j) const {
-    auto it = bonds_.find(normalize_bond_type(type_i, type_j));
-    if (it != bonds_.end()) {
-        return static_cast<size_t>(it - bonds_.begin());
+    auto it = bonds_index_.find(normalize_bond_type(type_i, type_j));
+    if (it != bonds_index_.end()) {
+        return it->second;
     } else {
         throw error("invalid bond type passed to bond_type_id, this is a bug");
     }
 }
 
 size_t DataTypes::angle_type_id(size_t type_i, size_t type_j, size_t type_k) const {
-    auto it = angles_.find(normalize_angle_type(type_i, type_j, type_k));
-    if (it != angles_.end()) {
-        return static_cast<size_t>(it - angles_.begin());
+    auto it = angles_index_.find(normalize_angle_type(type_i, type_j, type_k));
+    if (it != angles_index_.end()) {
+        return it->second;
     } else {
         throw error("invalid angle type passed to angle_type_id, this is a bug");
     }
 }
 
 size_t DataTypes::dihedral_type_id(size_t type_i, size_t type_j, size_t type_k, size_t type_m) const {
-    auto it = dihedrals_.find(normalize_dihedral_type(type_i, type_j, type_k, type_m));
-    if (it != dihedrals_.end()) {
-        return static_cast<size_t>(it - dihedrals_.begin());
+    auto it = dihedrals_index_.find(normalize_dihedral_type(type_i, type_j, type_k, type_m));
+    if (it != dihedrals_index_.end()) {
+        return it->second;
     } else {
         throw error("invalid dihedral type passed to dihedral_type_id, this is a bug");
     }
 }
 
 size_t DataTypes::improper_type_id(size_t type_i, size_t type_j, size_t type_k, size_t type_m) const {
-    auto it = impropers_.find(normalize_improper_type(type_i, type_j, type_k, type_m));
-    if (it != impropers_.end()) {
-        return static_cast<size_t>(it - impropers_.begin());
+    auto it = impropers_index_.find(normalize_improper_type(type_i, type_j, type_k, type_m));
+    if (it != impropers_index_.end()) {
+        return it->second;
     } else {
         throw error("invalid improper type passed to improper_type_id, this is a bug");
     }
@@ -775,66 +1105,89 @@ void LAMMPSDataFormat::write_next(const Frame& frame) {
         throw format_error("LAMMPS Data format only supports writting one frame");
     }
 
-    auto types = DataTypes(frame.topology());
-
-    write_header(types, frame);
-    write_types(types);
-    write_masses(types);
-    write_atoms(types, frame);
-    write_velocities(frame);
     auto& topology = frame.topology();
-    write_bonds(types, topology);
-    write_angles(types, topology);
-    write_dihedrals(types, topology);
-    write_impropers(types, topology);
+    auto types = DataTypes(topology);
+
+    // Format the whole file in memory first, then write it to the file in
+    // a single operation instead of one write per line
+    auto buffer = fmt::memory_buffer();
+    // pre-size the buffer from the per-record sizes (atoms dominate, with
+    // bonded terms around 30 bytes per line) to avoid reallocations while
+    // formatting
+    buffer.reserve(
+        96 * frame.size() +
+        30 * (topology.bonds().size() + topology.angles().size() +
+              topology.dihedrals().size() + topology.impropers().size()) +
+        1024
+    );
+    write_header(buffer, types, frame);
+    write_types(buffer, types);
+    write_masses(buffer, types);
+    write_atoms(buffer, types, frame);
+    write_velocities(buffer, frame);
+    write_bonds(buffer, types, topology);
+    write_angles(buffer, types, topology);
+    write_dihedrals(buffer, types, topology);
+    write_impropers(buffer, types, topology);
+
+    file_->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+/// Append `value` as decimal digits to `buffer`, followed by `separator`.
+/// `fmt::format_int` is a direct integer-to-characters conversion, without
+/// any format string to parse.
+static void append_integer(fmt::memory_buffer& buffer, size_t value, char separator) {
+    auto formatted = fmt::format_int(value);
+    buffer.append(formatted.data(), formatted.data() + formatted.size());
+    buffer.push_back(separator);
 }
 
-void LAMMPSDataFormat::write_header(const DataTypes& types, const Frame& frame) {
-    fmt::print(*file_, "LAMMPS data file -- atom_style full -- generated by chemfiles\n");
-    fmt::print(*file_, "{} atoms\n", frame.size());
-    fmt::print(*file_, "{} bonds\n", frame.topology().bonds().size());
-    fmt::print(*file_, "{} angles\n", frame.topology().angles().size());
-    fmt::print(*file_, "{} dihedrals\n", frame.topology().dihedrals().size());
-    fmt::print(*file_, "{} impropers\n", frame.topology().impropers().size());
+void LAMMPSDataFormat::write_header(fmt::memory_buffer& buffer, const DataTypes& types, const Frame& frame) {
+    fmt::format_to(buffer, "LAMMPS data file -- atom_style full -- generated by chemfiles\n");
+    fmt::format_to(buffer, "{} atoms\n", frame.size());
+    fmt::format_to(buffer, "{} bonds\n", frame.topology().bonds().size());
+    fmt::format_to(buffer, "{} angles\n", frame.topology().angles().size());
+    fmt::format_to(buffer, "{} dihedrals\n", frame.topology().dihedrals().size());
+    fmt::format_to(buffer, "{} impropers\n", frame.topology().impropers().size());
 
-    fmt::print(*file_, "{} atom types\n", types.atoms().size());
-    fmt::print(*file_, "{} bond types\n", types.bonds().size());
-    fmt::print(*file_, "{} angle types\n", types.angles().size());
-    fmt::print(*file_, "{} dihedral types\n", types.dihedrals().size());
-    fmt::print(*file_, "{} improper types\n", types.impropers().size());
+    fmt::format_to(buffer, "{} atom types\n", types.atoms().size());
+    fmt::format_to(buffer, "{} bond types\n", types.bonds().size());
+    fmt::format_to(buffer, "{} angle types\n", types.angles().size());
+    fmt::format_to(buffer, "{} dihedral types\n", types.dihedrals().size());
+    fmt::format_to(buffer, "{} improper types\n", types.impropers().size());
 
     auto matrix = frame.cell().matrix();
-    fmt::print(*file_, "0 {} xlo xhi\n", matrix[0][0]);
-    fmt::print(*file_, "0 {} ylo yhi\n", matrix[1][1]);
-    fmt::print(*file_, "0 {} zlo zhi\n", matrix[2][2]);
+    fmt::format_to(buffer, "0 {} xlo xhi\n", matrix[0][0]);
+    fmt::format_to(buffer, "0 {} ylo yhi\n", matrix[1][1]);
+    fmt::format_to(buffer, "0 {} zlo zhi\n", matrix[2][2]);
     if (frame.cell().shape() == UnitCell::TRICLINIC) {
         assert(tilt_factor(matrix, 1, 0) == 0);
         assert(tilt_factor(matrix, 2, 0) == 0);
         assert(tilt_factor(matrix, 2, 1) == 0);
-        fmt::print(*file_, "{} {} {} xy xz yz\n",
+        fmt::format_to(buffer, "{} {} {} xy xz yz\n",
             tilt_factor(matrix, 0, 1),
             tilt_factor(matrix, 0, 2),
             tilt_factor(matrix, 1, 2)
         );
     }
 
-    fmt::print(*file_, "\n");
+    fmt::format_to(buffer, "\n");
 }
 
-void LAMMPSDataFormat::write_types(const DataTypes& types) {
+void LAMMPSDataFormat::write_types(fmt::memory_buffer& buffer, const DataTypes& types) {
     auto& atoms = types.atoms().as_vec();
     if (!atoms.empty()) {
-        fmt::print(*file_, "# Pair Coeffs\n");
+        fmt::format_to(buffer, "# Pair Coeffs\n");
         for (size_t i=0; i<atoms.size(); i++) {
-            fmt::print(*file_, "# {} {}\n", i + 1, atoms[i].first);
+            fmt::format_to(buffer, "# {} {}\n", i + 1, atoms[i].first);
         }
     }
 
     auto& bonds = types.bonds().as_vec();
     if (!bonds.empty()) {
-        fmt::print(*file_, "\n# Bond Coeffs\n");
+        fmt::format_to(buffer, "\n# Bond Coeffs\n");
         for (size_t i=0; i<bonds.size(); i++) {
-            fmt::print(*file_, "# {} {}-{}\n", i + 1,
+            fmt::format_to(buffer, "# {} {}-{}\n", i + 1,
                 atoms[std::get<0>(bonds[i])].first,
                 atoms[std::get<1>(bonds[i])].first
             );
@@ -843,9 +1196,9 @@ void LAMMPSDataFormat::write_types(const DataTypes& types) {
 
     auto& angles = types.angles().as_vec();
     if (!angles.empty()) {
-        fmt::print(*file_, "\n# Angle Coeffs\n");
+        fmt::format_to(buffer, "\n# Angle Coeffs\n");
         for (size_t i=0; i<angles.size(); i++) {
-            fmt::print(*file_, "# {} {}-{}-{}\n", i + 1,
+            fmt::format_to(buffer, "# {} {}-{}-{}\n", i + 1,
                 atoms[std::get<0>(angles[i])].first,
                 atoms[std::get<1>(angles[i])].first,
                 atoms[std::get<2>(angles[i])].first
@@ -855,9 +1208,9 @@ void LAMMPSDataFormat::write_types(const DataTypes& types) {
 
     auto& dihedrals = types.dihedrals().as_vec();
     if (!dihedrals.empty()) {
-        fmt::print(*file_, "\n# Dihedrals Coeffs\n");
+        fmt::format_to(buffer, "\n# Dihedrals Coeffs\n");
         for (size_t i=0; i<dihedrals.size(); i++) {
-            fmt::print(*file_, "# {} {}-{}-{}-{}\n", i + 1,
+            fmt::format_to(buffer, "# {} {}-{}-{}-{}\n", i + 1,
                 atoms[std::get<0>(dihedrals[i])].first,
                 atoms[std::get<1>(dihedrals[i])].first,
                 atoms[std::get<2>(dihedrals[i])].first,
@@ -868,9 +1221,9 @@ void LAMMPSDataFormat::write_types(const DataTypes& types) {
 
     auto& impropers = types.impropers().as_vec();
     if (!impropers.empty()) {
-        fmt::print(*file_, "\n# Impropers Coeffs\n");
+        fmt::format_to(buffer, "\n# Impropers Coeffs\n");
         for (size_t i=0; i<impropers.size(); i++) {
-            fmt::print(*file_, "# {} {}-{}-{}-{}\n", i + 1,
+            fmt::format_to(buffer, "# {} {}-{}-{}-{}\n", i + 1,
                 atoms[std::get<0>(impropers[i])].first,
                 atoms[std::get<1>(impropers[i])].first,
                 atoms[std::get<2>(impropers[i])].first,
@@ -880,108 +1233,127 @@ void LAMMPSDataFormat::write_types(const DataTypes& types) {
     }
 }
 
-void LAMMPSDataFormat::write_masses(const DataTypes& types) {
-    fmt::print(*file_, "\nMasses\n\n");
+void LAMMPSDataFormat::write_masses(fmt::memory_buffer& buffer, const DataTypes& types) {
+    fmt::format_to(buffer, "\nMasses\n\n");
     auto& atoms = types.atoms().as_vec();
     for (size_t i=0; i<atoms.size(); i++) {
-        fmt::print(*file_, "{} {} # {}\n", i + 1, atoms[i].second, atoms[i].first);
+        fmt::format_to(buffer, "{} {} # {}\n", i + 1, atoms[i].second, atoms[i].first);
     }
 }
 
-void LAMMPSDataFormat::write_atoms(const DataTypes& types, const Frame& frame) {
-    fmt::print(*file_, "\nAtoms # full\n\n");
+void LAMMPSDataFormat::write_atoms(fmt::memory_buffer& buffer, const DataTypes& types, const Frame& frame) {
+    fmt::format_to(buffer, "\nAtoms # full\n\n");
     auto positions = frame.positions();
     auto molids = guess_molecules(frame);
+    auto& topology = frame.topology();
+    auto& atom_type_ids = types.atom_type_ids();
     for (size_t i=0; i<frame.size(); i++) {
-        auto& atom = frame.topology()[i];
-        auto molid = molids[i];
-        fmt::print(*file_, "{} {} {} {} {} {} {} # {}\n",
-            i + 1, molid + 1, types.atom_type_id(atom) + 1, atom.charge(),
-            positions[i][0], positions[i][1], positions[i][2],
+        auto& atom = topology[i];
+        append_integer(buffer, i + 1, ' ');
+        append_integer(buffer, molids[i] + 1, ' ');
+        append_integer(buffer, atom_type_ids[i] + 1, ' ');
+        // load the coordinates once instead of re-indexing the position
+        // array for each formatted argument
+        auto& position = positions[i];
+        fmt::format_to(buffer, "{} {} {} {} # {}\n",
+            atom.charge(), position[0], position[1], position[2],
             atom.type()
         );
     }
 }
 
-void LAMMPSDataFormat::write_velocities(const Frame& frame) {
+void LAMMPSDataFormat::write_velocities(fmt::memory_buffer& buffer, const Frame& frame) {
     if (!frame.velocities()) { return; }
 
-    fmt::print(*file_, "\nVelocities\n\n");
+    fmt::format_to(buffer, "\nVelocities\n\n");
     auto velocities = *frame.velocities();
     for (size_t i=0; i<frame.size(); i++) {
-        fmt::print(*file_, "{} {} {} {}\n",
-            i + 1, velocities[i][0], velocities[i][1], velocities[i][2]
+        append_integer(buffer, i + 1, ' ');
+        auto& velocity = velocities[i];
+        fmt::format_to(buffer, "{} {} {}\n",
+            velocity[0], velocity[1], velocity[2]
         );
     }
 }
 
-void LAMMPSDataFormat::write_bonds(const DataTypes& types, const Topology& topology) {
+void LAMMPSDataFormat::write_bonds(fmt::memory_buffer& buffer, const DataTypes& types, const Topology& topology) {
     if (topology.bonds().empty()) { return; }
 
-    fmt::print(*file_, "\nBonds\n\n");
+    fmt::format_to(buffer, "\nBonds\n\n");
+    auto& atom_type_ids = types.atom_type_ids();
     size_t bond_id = 1;
     for (auto bond: topology.bonds()) {
-        auto type_i = types.atom_type_id(topology[bond[0]]);
-        auto type_j = types.atom_type_id(topology[bond[1]]);
+        auto type_i = atom_type_ids[bond[0]];
+        auto type_j = atom_type_ids[bond[1]];
         auto bond_type_id = types.bond_type_id(type_i, type_j);
-        fmt::print(*file_, "{} {} {} {}\n",
-            bond_id, bond_type_id + 1, bond[0] + 1, bond[1] + 1
-        );
+        append_integer(buffer, bond_id, ' ');
+        append_integer(buffer, bond_type_id + 1, ' ');
+        append_integer(buffer, bond[0] + 1, ' ');
+        append_integer(buffer, bond[1] + 1, '\n');
         bond_id++;
     }
 }
 
-void LAMMPSDataFormat::write_angles(const DataTypes& types, const Topology& topology) {
+void LAMMPSDataFormat::write_angles(fmt::memory_buffer& buffer, const DataTypes& types, const Topology& topology) {
     if (topology.angles().empty()) { return; }
 
-    fmt::print(*file_, "\nAngles\n\n");
+    fmt::format_to(buffer, "\nAngles\n\n");
+    auto& atom_type_ids = types.atom_type_ids();
     size_t angle_id = 1;
     for (auto angle: topology.angles()) {
-        auto type_i = types.atom_type_id(topology[angle[0]]);
-        auto type_j = types.atom_type_id(topology[angle[1]]);
-        auto type_k = types.atom_type_id(topology[angle[2]]);
+        auto type_i = atom_type_ids[angle[0]];
+        auto type_j = atom_type_ids[angle[1]];
+        auto type_k = atom_type_ids[angle[2]];
         auto angle_type_id = types.angle_type_id(type_i, type_j, type_k);
-        fmt::print(*file_, "{} {} {} {} {}\n",
-            angle_id, angle_type_id + 1, angle[0] + 1, angle[1] + 1, angle[2] + 1
-        );
+        append_integer(buffer, angle_id, ' ');
+        append_integer(buffer, angle_type_id + 1, ' ');
+        append_integer(buffer, angle[0] + 1, ' ');
+        append_integer(buffer, angle[1] + 1, ' ');
+        append_integer(buffer, angle[2] + 1, '\n');
         angle_id++;
     }
 }
 
-void LAMMPSDataFormat::write_dihedrals(const DataTypes& types, const Topology& topology) {
+void LAMMPSDataFormat::write_dihedrals(fmt::memory_buffer& buffer, const DataTypes& types, const Topology& topology) {
     if (topology.dihedrals().empty()) { return; }
 
-    fmt::print(*file_, "\nDihedrals\n\n");
+    fmt::format_to(buffer, "\nDihedrals\n\n");
+    auto& atom_type_ids = types.atom_type_ids();
     size_t dihedral_id = 1;
     for (auto dihedral: topology.dihedrals()) {
-        auto type_i = types.atom_type_id(topology[dihedral[0]]);
-        auto type_j = types.atom_type_id(topology[dihedral[1]]);
-        auto type_k = types.atom_type_id(topology[dihedral[2]]);
-        auto type_m = types.atom_type_id(topology[dihedral[3]]);
+        auto type_i = atom_type_ids[dihedral[0]];
+        auto type_j = atom_type_ids[dihedral[1]];
+        auto type_k = atom_type_ids[dihedral[2]];
+        auto type_m = atom_type_ids[dihedral[3]];
         auto dihedral_type_id = types.dihedral_type_id(type_i, type_j, type_k, type_m);
-        fmt::print(*file_, "{} {} {} {} {} {}\n",
-            dihedral_id, dihedral_type_id + 1,
-            dihedral[0] + 1, dihedral[1] + 1, dihedral[2] + 1, dihedral[3] + 1
-        );
+        append_integer(buffer, dihedral_id, ' ');
+        append_integer(buffer, dihedral_type_id + 1, ' ');
+        append_integer(buffer, dihedral[0] + 1, ' ');
+        append_integer(buffer, dihedral[1] + 1, ' ');
+        append_integer(buffer, dihedral[2] + 1, ' ');
+        append_integer(buffer, dihedral[3] + 1, '\n');
         dihedral_id++;
     }
 }
 
-void LAMMPSDataFormat::write_impropers(const DataTypes& types, const Topology& topology) {
+void LAMMPSDataFormat::write_impropers(fmt::memory_buffer& buffer, const DataTypes& types, const Topology& topology) {
     if (topology.impropers().empty()) { return; }
 
-    fmt::print(*file_, "\nImpropers\n\n");
+    fmt::format_to(buffer, "\nImpropers\n\n");
+    auto& atom_type_ids = types.atom_type_ids();
     size_t improper_id = 1;
     for (auto improper: topology.impropers()) {
-        auto type_i = types.atom_type_id(topology[improper[0]]);
-        auto type_j = types.atom_type_id(topology[improper[1]]);
-        auto type_k = types.atom_type_id(topology[improper[2]]);
-        auto type_m = types.atom_type_id(topology[improper[3]]);
+        auto type_i = atom_type_ids[improper[0]];
+        auto type_j = atom_type_ids[improper[1]];
+        auto type_k = atom_type_ids[improper[2]];
+        auto type_m = atom_type_ids[improper[3]];
         auto improper_type_id = types.improper_type_id(type_i, type_j, type_k, type_m);
-        fmt::print(*file_, "{} {} {} {} {} {}\n",
-            improper_id, improper_type_id + 1,
-            improper[0] + 1, improper[1] + 1, improper[2] + 1, improper[3] + 1
-        );
+        append_integer(buffer, improper_id, ' ');
+        append_integer(buffer, improper_type_id + 1, ' ');
+        append_integer(buffer, improper[0] + 1, ' ');
+        append_integer(buffer, improper[1] + 1, ' ');
+        append_integer(buffer, improper[2] + 1, ' ');
+        append_integer(buffer, improper[3] + 1, '\n');
         improper_id++;
     }
 }
@@ -996,64 +1368,70 @@ std::string split_comment(std::string& line) {
     return comment;
 }
 
-bool is_unused_header(const std::string& line) {
-    return (line.find("angles") != std::string::npos) ||
-           (line.find("dihedrals") != std::string::npos) ||
-           (line.find("impropers") != std::string::npos) ||
-           (line.find("bond types") != std::string::npos) ||
-           (line.find("angle types") != std::string::npos) ||
-           (line.find("dihedral types") != std::string::npos) ||
-           (line.find("improper types") != std::string::npos) ||
-           (line.find("extra bond per atom") != std::string::npos) ||
-           (line.find("extra angle per atom") != std::string::npos) ||
-           (line.find("extra dihedral per atom") != std::string::npos) ||
-           (line.find("extra improper per atom") != std::string::npos) ||
-           (line.find("extra special per atom") != std::string::npos) ||
-           (line.find("ellipsoids") != std::string::npos) ||
-           (line.find("lines") != std::string::npos) ||
-           (line.find("triangles") != std::string::npos) ||
-           (line.find("bodies") != std::string::npos);
-}
-
 std::vector<size_t> guess_molecules(const Frame& frame) {
-    // Initialize the molids vector with each atom in its own molecule
-    auto molids = std::vector<size_t>();
-    molids.reserve(frame.size());
-    for (size_t i=0; i<frame.size(); i++) {
-        molids.push_back(i);
+    auto& bonds = frame.topology().bonds();
+    if (bonds.empty()) {
+        // without bonds, every atom is its own molecule
+        auto molids = std::vector<size_t>(frame.size());
+        for (size_t i=0; i<frame.size(); i++) {
+            molids[i] = i;
+        }
+        return molids;
     }
 
-    for (auto bond: frame.topology().bonds()) {
-        auto i = bond[0];
-        auto j = bond[1];
+    // Molecules are the connected components of the bond graph, computed
+    // here with union-find: full path compression in `find` and union by
+    // rank keep the trees flat, so each bond is processed in near
+    // constant time.
+    auto parent = std::vector<size_t>(frame.size());
+    for (size_t i=0; i<frame.size(); i++) {
+        parent[i] = i;
+    }
+    auto rank = std::vector<size_t>(frame.size(), 0);
 
-        // Merge the bigger molid in the smaller one
-        size_t new_id = molids[i];
-        size_t old_id = molids[j];
-        if (molids[i] > molids[j]) {
-            new_id = molids[j];
-            old_id = molids[i];
+    auto find = [&parent](size_t x) {
+        auto root = x;
+        while (parent[root] != root) {
+            root = parent[root];
         }
-
-        for (auto& molid: molids) {
-            if (molid == old_id) {
-                molid = new_id;
-            }
+        // second pass: point every node on the path directly at the root
+        while (parent[x] != root) {
+            auto next = parent[x];
+            parent[x] = root;
+            x = next;
+        }
+        return root;
+    };
+
+    for (auto bond: bonds) {
+        auto root_i = find(bond[0]);
+        auto root_j = find(bond[1]);
+        if (root_i == root_j) {
+            continue;
+        }
+        // attach the shorter tree under the taller one
+        if (rank[root_i] < rank[root_j]) {
+            std::swap(root_i, root_j);
+        }
+        parent[root_j] = root_i;
+        if (rank[root_i] == rank[root_j]) {
+            rank[root_i] += 1;
         }
     }
 
-    // Make sure the molids are consecutives
-    std::unordered_map<size_t, size_t> molids_mapping;
-    for (auto& molid: molids) {
-        auto it = molids_mapping.find(molid);
-        if (it != molids_mapping.end()) {
-            molid = it->second;
-        } else {
-            // We've not found this id yet
-            auto new_id = molids_mapping.size();
-            molids_mapping.insert({molid, new_id});
-            molid = new_id;
+    // Assign consecutive molecule ids, in order of the first atom of each
+    // molecule
+    auto invalid = static_cast<size_t>(-1);
+    auto dense_ids = std::vector<size_t>(frame.size(), invalid);
+    auto molids = std::vector<size_t>(frame.size());
+    size_t next_id = 0;
+    for (size_t i=0; i<frame.size(); i++) {
+        auto root = find(i);
+        if (dense_ids[root] == invalid) {
+            dense_ids[root] = next_id;
+            next_id++;
         }
+        molids[i] = dense_ids[root];
     }
 
     return molids;
@@ -1063,15 +1441,9 @@ double tilt_factor(const Matrix3D& matrix, size_t i, size_t j) {
     assert(i != j);
     auto factor = matrix[i][j];
     auto a = matrix[i][i];
-    if (factor >= 0) {
-        while (fabs(factor) > a / 2) {
-            factor -= a;
-        }
-    } else {
-        while (factor < -a / 2) {
-            factor += a;
-        }
-    }
+    // reduce the factor to [-a/2, a/2] in a single operation instead of
+    // repeatedly adding or subtracting `a`
+    factor = std::remainder(factor, a);
 
     // Correct for rounding errors in calculations of sin/cos
     if (fabs(factor) < 1e-15) {
@@ -1081,7 +1453,7 @@ double tilt_factor(const Matrix3D& matrix, size_t i, size_t j) {
     return factor;
 }
 
-std::streampos LAMMPSDataFormat::forward() {
+StepPosition LAMMPSDataFormat::forward() {
     // LAMMPS Data only supports one step, so always act like there is only one
     auto position = file_->tellg();
     if (position == std::streampos(0)) {
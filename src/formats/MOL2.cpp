@@ -3,12 +3,15 @@
 
 #include <cctype>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
 #include <array>
 #include <string>
 #include <vector>
 #include <memory>
 #include <istream>
+#include <algorithm>
 #include <unordered_map>
 
 #include <fmt/ostream.h>
@@ -41,6 +44,106 @@ template<> FormatInfo chemfiles::format_information<MOL2Format>() {
 /// Fast-forward the file until the tag is found.
 static std::streampos read_until(TextFile& file, const std::string& tag);
 
+/// Cursor over the fields of an atom or bond line. Parsing one field at a
+/// time with strtoul/strtod is much faster than scan, which re-interprets
+/// its format string for every line.
+struct token_cursor {
+    const char* position;
+
+    /// Try to parse an integer field, advancing past it on success
+    bool integer(unsigned long& value) {
+        char* end = nullptr;
+        auto parsed = std::strtoul(position, &end, 10);
+        if (end == position) {
+            return false;
+        }
+        position = end;
+        value = parsed;
+        return true;
+    }
+
+    /// Try to parse a floating point field, advancing past it on success
+    bool real(double& value) {
+        char* end = nullptr;
+        auto parsed = std::strtod(position, &end);
+        if (end == position) {
+            return false;
+        }
+        position = end;
+        value = parsed;
+        return true;
+    }
+
+    /// Copy the next whitespace-separated field into `output`, truncating
+    /// it to `count - 1` characters like scanf %s would
+    template<size_t count>
+    bool word(char (&output)[count]) {
+        while (*position == ' ' || *position == '\t' || *position == '\r' || *position == '\n') {
+            position++;
+        }
+        if (*position == '\0') {
+            return false;
+        }
+        size_t size = 0;
+        while (*position != '\0' && *position != ' ' && *position != '\t' && *position != '\r' && *position != '\n') {
+            if (size < count - 1) {
+                output[size] = *position;
+                size++;
+            }
+            position++;
+        }
+        output[size] = '\0';
+        return true;
+    }
+};
+
+/// Parse the atom and bond counts from the counts line of a MOLECULE
+/// record, without splitting the line into a vector of strings. The bond
+/// count is optional and defaults to 0.
+static void parse_counts(const std::string& line, size_t& natoms, size_t& nbonds) {
+    auto it = line.c_str();
+    while (*it == ' ' || *it == '\t') {
+        it++;
+    }
+    // strtoull silently wraps negative values around instead of failing
+    if (*it == '-') {
+        throw format_error("could not parse the number of atoms in '{}'", line);
+    }
+    char* end = nullptr;
+    natoms = static_cast<size_t>(std::strtoull(it, &end, 10));
+    if (end == it || (*end != '\0' && *end != ' ' && *end != '\t' && *end != '\r' && *end != '\n')) {
+        throw format_error("could not parse the number of atoms in '{}'", line);
+    }
+
+    auto start = end;
+    while (*start == ' ' || *start == '\t') {
+        start++;
+    }
+    if (*start == '\0' || *start == '\r' || *start == '\n') {
+        // the bond count is optional
+        nbonds = 0;
+        return;
+    }
+    if (*start == '-') {
+        throw format_error("could not parse the number of bonds in '{}'", line);
+    }
+    nbonds = static_cast<size_t>(std::strtoull(start, &end, 10));
+    if (end == start || (*end != '\0' && *end != ' ' && *end != '\t' && *end != '\r' && *end != '\n')) {
+        throw format_error("could not parse the number of bonds in '{}'", line);
+    }
+}
+
+/// Append `value` as decimal digits right-aligned in a field of `width`
+/// characters. `fmt::format_int` is a direct integer-to-characters
+/// conversion, without any format string to parse.
+static void append_padded_integer(fmt::memory_buffer& buffer, size_t value, size_t width) {
+    auto formatted = fmt::format_int(value);
+    for (auto i = formatted.size(); i < width; i++) {
+        buffer.push_back(' ');
+    }
+    buffer.append(formatted.data(), formatted.data() + formatted.size());
+}
+
 void MOL2Format::read_next(Frame& frame) {
     auto line = trim(file_->readline());
     if (line != "@<TRIPOS>MOLECULE") {
@@ -50,16 +153,12 @@ void MOL2Format::read_next(Frame& frame) {
     frame.set("name", trim(file_->readline()) );
     line = file_->readline();
 
-    const auto counts = split(line, ' ');
-
-    auto natoms = parse<size_t>(counts[0]);
+    size_t natoms = 0;
     size_t nbonds = 0;
-
-    if (counts.size() >= 2) {
-        nbonds = parse<size_t>(counts[1]);
-    }
+    parse_counts(line, natoms, nbonds);
 
     residues_.clear();
+    residues_.reserve(natoms / 8);
     frame.resize(0);
     frame.reserve(natoms);
 
@@ -98,30 +197,53 @@ void MOL2Format::read_next(Frame& frame) {
 }
 
 void MOL2Format::read_atoms(Frame& frame, size_t natoms, bool charges) {
-    auto lines = file_->readlines(natoms);
-
-    for (const auto& line : lines) {
+    // read the lines one by one into a reused buffer instead of
+    // materializing all of them at once with readlines
+    std::string line;
+    // the same few types usually repeat over all the atoms: remember
+    // whether a dot-less type is a known element instead of searching the
+    // periodic table again for every atom
+    std::unordered_map<std::string, bool> known_elements;
+    std::string type_key;
+    for (size_t n=0; n<natoms; n++) {
+        file_->readline(line);
         unsigned long id, resid;
         char atom_name[32], sybyl_type[32], res_name[32];
         double x, y, z;
         double charge = 0;
 
-        if (charges) {
-            scan(line, " %lu %31s %lf %lf %lf %31s %lu %31s %lf",
-                &id, &atom_name[0], &x, &y, &z, &sybyl_type[0], &resid, &res_name[0], &charge
-            );
-        } else {
-            scan(line, " %lu %31s %lf %lf %lf %31s %lu %31s",
-                &id, &atom_name[0], &x, &y, &z, &sybyl_type[0], &resid, &res_name[0]
-            );
+        auto cursor = token_cursor{line.c_str()};
+        bool parsed = cursor.integer(id) && cursor.word(atom_name) &&
+                      cursor.real(x) && cursor.real(y) && cursor.real(z) &&
+                      cursor.word(sybyl_type) && cursor.integer(resid) &&
+                      cursor.word(res_name);
+        if (parsed && charges) {
+            parsed = cursor.real(charge);
+        }
+        if (!parsed) {
+            throw format_error("could not read atom line '{}' in MOL2 file", line);
         }
 
         std::string atom_type;
         bool is_sybyl;
 
-        if (std::string(sybyl_type).find('.') != std::string::npos || find_in_periodic_table(sybyl_type)) {
-            auto my_split = split(sybyl_type, '.');
-            atom_type = my_split[0];
+        const char* dot = std::strchr(sybyl_type, '.');
+        bool is_element = false;
+        if (dot == nullptr) {
+            type_key.assign(sybyl_type);
+            auto known = known_elements.find(type_key);
+            if (known == known_elements.end()) {
+                bool found = static_cast<bool>(find_in_periodic_table(type_key));
+                known = known_elements.emplace(type_key, found).first;
+            }
+            is_element = known->second;
+        }
+        if (dot != nullptr || is_element) {
+            // the atom type is everything before the first dot
+            atom_type.assign(
+                sybyl_type,
+                dot != nullptr ? static_cast<size_t>(dot - sybyl_type) : std::strlen(sybyl_type)
+            );
             is_sybyl = true;
         } else {
             is_sybyl = false;
@@ -147,26 +269,48 @@ void MOL2Format::read_atoms(Frame& frame, size_t natoms, bool charges) {
         frame.add_atom(std::move(atom), {x, y, z});
 
         size_t current_atom = frame.size() - 1;
-        if (residues_.find(resid) == residues_.end()) {
+        if (!residues_.empty() && residues_.back().first == resid) {
+            // Fast path: this atom is in the same residue as the previous one
+            residues_.back().second.add_atom(current_atom);
+        } else if (residues_.empty() || resid > residues_.back().first) {
             Residue residue(res_name, resid);
             residue.add_atom(current_atom);
-            residues_.insert({resid, residue});
+
+            residues_.emplace_back(resid, std::move(residue));
         } else {
-            // Just add this atom to the residue
-            residues_.at(resid).add_atom(current_atom);
+            // Out of order residue id, find where it belongs to keep the
+            // list sorted
+            auto it = std::lower_bound(residues_.begin(), residues_.end(), resid,
+                [](const std::pair<size_t, Residue>& entry, size_t id) {
+                    return entry.first < id;
+                }
+            );
+            if (it != residues_.end() && it->first == resid) {
+                it->second.add_atom(current_atom);
+            } else {
+                Residue residue(res_name, resid);
+                residue.add_atom(current_atom);
+
+                residues_.insert(it, {resid, std::move(residue)});
+            }
         }
 
     }
 }
 
 void MOL2Format::read_bonds(Frame& frame, size_t nbonds) {
-    auto lines = file_->readlines(nbonds);
-
-    for (const auto& line : lines) {
+    std::string line;
+    for (size_t n=0; n<nbonds; n++) {
+        file_->readline(line);
         unsigned long id, id_1, id_2;
         char bond_order[32] = {0};
 
-        scan(line, " %lu %lu %lu %31s", &id, &id_1, &id_2, &bond_order[0]);
+        auto cursor = token_cursor{line.c_str()};
+        bool parsed = cursor.integer(id) && cursor.integer(id_1) &&
+                      cursor.integer(id_2) && cursor.word(bond_order);
+        if (!parsed) {
+            throw format_error("could not read bond line '{}' in MOL2 file", line);
+        }
 
         // MOL2 is 1 index-based, not 0
         --id_1;
@@ -178,23 +322,28 @@ void MOL2Format::read_bonds(Frame& frame, size_t nbonds) {
             );
         }
 
-        Bond::BondOrder bo;
-        std::string bond_order_str(bond_order);
-
-        if (bond_order_str == "1") {
+        // dispatch on the first character instead of up to six string
+        // comparisons; 'du' (dummy bond) and anything unknown map to UNKNOWN
+        Bond::BondOrder bo = Bond::UNKNOWN;
+        switch (bond_order[0]) {
+        case '1':
             bo = Bond::SINGLE;
-        } else if (bond_order_str == "2") {
+            break;
+        case '2':
             bo = Bond::DOUBLE;
-        } else if (bond_order_str == "3") {
+            break;
+        case '3':
             bo = Bond::TRIPLE;
-        } else if (bond_order_str == "ar") {
-            bo = Bond::AROMATIC;
-        } else if (bond_order_str == "am") {
-            bo = Bond::AMIDE;
-        } else if (bond_order_str == "du") { // du is a dummy bond
-            bo = Bond::UNKNOWN;
-        } else {
-            bo = Bond::UNKNOWN;
+            break;
+        case 'a':
+            if (bond_order[1] == 'r') {
+                bo = Bond::AROMATIC;
+            } else if (bond_order[1] == 'm') {
+                bo = Bond::AMIDE;
+            }
+            break;
+        default:
+            break;
         }
 
         frame.add_bond(id_1, id_2, bo);
@@ -212,7 +361,7 @@ std::streampos read_until(TextFile& file, const std::string& tag) {
     throw file_error("file ended before tag '{}' was found", tag);
 }
 
-std::streampos MOL2Format::forward() {
+StepPosition MOL2Format::forward() {
     if (!*file_) {
         return std::streampos(-1);
     }
@@ -222,12 +371,9 @@ std::streampos MOL2Format::forward() {
             file_->skipline();
             auto line = file_->readline();
 
-            const auto counts = split(line, ' ');
-            auto natoms = parse<size_t>(counts[0]);
+            size_t natoms = 0;
             size_t nbonds = 0;
-            if (counts.size() >= 2) {
-                nbonds = parse<size_t>(counts[1]);
-            }
+            parse_counts(line, natoms, nbonds);
 
             read_until(*file_, "@<TRIPOS>ATOM");
             file_->skiplines(natoms);
@@ -245,69 +391,98 @@ std::streampos MOL2Format::forward() {
 }
 
 void MOL2Format::write_next(const Frame& frame) {
-    fmt::print(*file_, "@<TRIPOS>MOLECULE\n");
-    fmt::print(*file_, "{}\n", frame.get<Property::STRING>("name").value_or(""));
+    auto& topology = frame.topology();
+    auto natoms = frame.size();
+
+    // Format the whole frame in memory first, then write it to the file in
+    // a single operation instead of one write per line
+    auto buffer = fmt::memory_buffer();
+    // pre-size the buffer from the per-record sizes to avoid reallocations
+    // while formatting
+    buffer.reserve(
+        96 * natoms + 24 * topology.bonds().size() + 512
+    );
+    fmt::format_to(buffer, "@<TRIPOS>MOLECULE\n");
+    fmt::format_to(buffer, "{}\n", frame.get<Property::STRING>("name").value_or(""));
 
-    // Start after the maximal residue id for atoms without associated residue
+    // Start after the maximal residue id for atoms without associated residue,
+    // and resolve the residue of each atom in a single pass over the residues
+    // instead of one hash lookup per atom in the loop below
     uint64_t max_resid = 0;
-    for (const auto& residue: frame.topology().residues()) {
+    auto atom_residues = std::vector<const Residue*>(natoms, nullptr);
+    for (const auto& residue: topology.residues()) {
         auto resid = residue.id();
         if (resid && resid.value() > max_resid) {
             max_resid = resid.value();
         }
+        for (auto atom: residue) {
+            // residues can reference atoms that are not in the frame;
+            // ignore them like the per-atom residue lookup did
+            if (atom < natoms) {
+                atom_residues[atom] = &residue;
+            }
+        }
     }
 
-    const auto& bonds = frame.topology().bonds();
+    const auto& bonds = topology.bonds();
 
     // Basic format taken from VMD Molfiles
-    fmt::print(*file_, "{:4d}  {:4d}    1    0    0\n",
-        frame.size(), bonds.size()
+    fmt::format_to(buffer, "{:4d}  {:4d}    1    0    0\n",
+        natoms, bonds.size()
     );
 
-    fmt::print(*file_, "SMALL\nUSER_CHARGES\n\n@<TRIPOS>ATOM\n");
+    fmt::format_to(buffer, "SMALL\nUSER_CHARGES\n\n@<TRIPOS>ATOM\n");
 
     auto& positions = frame.positions();
-    for (size_t i = 0; i < frame.size(); i++) {
-
-        std::string resname;
-        std::string resid;
-
-        auto residue = frame.topology().residue_for_atom(i);
-        if (residue) {
-            resname = residue->name();
-
-            if (residue->id()) {
-                resid = std::to_string(residue->id().value());
-            } else {
-                resid = std::to_string(++max_resid);
-            }
+    // residue names and sybyl types are referenced in place, and residue
+    // ids formatted straight into the buffer, instead of creating three
+    // std::string per atom
+    static const std::string NO_RESIDUE_NAME = "XXX";
+    for (size_t i = 0; i < natoms; i++) {
+        const std::string* resname;
+        uint64_t resid;
+
+        auto residue = atom_residues[i];
+        if (residue != nullptr) {
+            resname = &residue->name();
+            resid = residue->id() ? residue->id().value() : ++max_resid;
         } else {
-            resname = "XXX";
-            resid = std::to_string(++max_resid);
+            resname = &NO_RESIDUE_NAME;
+            resid = ++max_resid;
         }
 
-        std::string sybyl;
-        if (frame[i].get("sybyl") && frame[i].get("sybyl")->kind() == Property::STRING) {
-            sybyl = frame[i].get("sybyl")->as_string();
+        const auto& atom = frame[i];
+        const std::string* sybyl;
+        auto sybyl_property = atom.get("sybyl");
+        if (sybyl_property && sybyl_property->kind() == Property::STRING) {
+            sybyl = &sybyl_property->as_string();
         } else {
-            sybyl = frame[i].type();
+            sybyl = &atom.type();
             warning("MOL2 writer", "sybyl type is not set, using element type instead");
         }
 
-        fmt::print(
-            *file_,
-            "{:4d} {:4s}  {:.6f} {:.6f} {:.6f} {:s} {} {} {:.6f}\n",
-            i + 1, frame[i].name(), positions[i][0], positions[i][1], positions[i][2], sybyl, resid, resname, frame[i].charge()
+        append_padded_integer(buffer, i + 1, 4);
+        buffer.push_back(' ');
+        const auto& name = atom.name();
+        buffer.append(name.data(), name.data() + name.size());
+        for (auto k = name.size(); k < 4; k++) {
+            buffer.push_back(' ');
+        }
+        fmt::format_to(
+            buffer,
+            "  {:.6f} {:.6f} {:.6f} {} {} {} {:.6f}\n",
+            positions[i][0], positions[i][1], positions[i][2], *sybyl, resid, *resname, atom.charge()
         );
     }
 
-    fmt::print(*file_, "@<TRIPOS>BOND\n");
+    fmt::format_to(buffer, "@<TRIPOS>BOND\n");
 
-    auto& bond_orders = frame.topology().bond_orders();
+    auto& bond_orders = topology.bond_orders();
 
     for (size_t i = 0; i < bonds.size(); i++) {
 
-        std::string bond_order;
+        // string constants instead of a std::string built for every bond
+        const char* bond_order = "du";
         switch (bond_orders[i]) {
             case Bond::SINGLE:
                 bond_order = "1";
@@ -326,24 +501,38 @@ void MOL2Format::write_next(const Frame& frame) {
                 break;
             case Bond::UNKNOWN:
             default:
-                bond_order = "du";
                 break;
         }
 
-        fmt::print(*file_, "{:4d}  {:4d}  {:4d}    {}\n",
-            i + 1, bonds[i][0] + 1, bonds[i][1] + 1, bond_order
-        );
+        auto& bond = bonds[i];
+        append_padded_integer(buffer, i + 1, 4);
+        buffer.push_back(' ');
+        buffer.push_back(' ');
+        append_padded_integer(buffer, bond[0] + 1, 4);
+        buffer.push_back(' ');
+        buffer.push_back(' ');
+        append_padded_integer(buffer, bond[1] + 1, 4);
+        for (size_t k = 0; k < 4; k++) {
+            buffer.push_back(' ');
+        }
+        buffer.append(bond_order, bond_order + std::strlen(bond_order));
+        buffer.push_back('\n');
     }
 
     auto cell = frame.cell();
     if (cell.shape() != UnitCell::INFINITE) {
-        fmt::print(*file_, "@<TRIPOS>CRYSIN\n");
-        fmt::print(*file_, "   {:.4f}   {:.4f}   {:.4f}   {:.4f}   {:.4f}   {:.4f} 1 1\n",
+        fmt::format_to(buffer, "@<TRIPOS>CRYSIN\n");
+        fmt::format_to(buffer, "   {:.4f}   {:.4f}   {:.4f}   {:.4f}   {:.4f}   {:.4f} 1 1\n",
             cell.a(), cell.b(), cell.c(), cell.alpha(), cell.beta(), cell.gamma()
         );
     }
 
-    fmt::print(*file_,"@<TRIPOS>SUBSTRUCTURE\n");
-    fmt::print(*file_,"   1 ****        1 TEMP                        ");
-    fmt::print(*file_,"0 ****  **** 0 ROOT\n\n");
+    // the substructure block is fully constant, append it in one piece
+    static const char SUBSTRUCTURE[] =
+        "@<TRIPOS>SUBSTRUCTURE\n"
+        "   1 ****        1 TEMP                        "
+        "0 ****  **** 0 ROOT\n\n";
+    buffer.append(SUBSTRUCTURE, SUBSTRUCTURE + sizeof(SUBSTRUCTURE) - 1);
+
+    file_->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 }
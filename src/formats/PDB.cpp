@@ -1,10 +1,12 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <cctype>
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
-#include <map>
 #include <tuple>
 #include <array>
 #include <string>
@@ -18,6 +20,7 @@
 
 #include "chemfiles/File.hpp"
 #include "chemfiles/Format.hpp"
+#include "chemfiles/files/MemoryMappedFile.hpp"
 #include "chemfiles/Atom.hpp"
 #include "chemfiles/Frame.hpp"
 #include "chemfiles/Property.hpp"
@@ -30,6 +33,7 @@
 #include "chemfiles/utils.hpp"
 #include "chemfiles/warnings.hpp"
 #include "chemfiles/ErrorFmt.hpp"
+#include "chemfiles/unreachable.hpp"
 #include "chemfiles/external/optional.hpp"
 
 #include "chemfiles/formats/PDB.hpp"
@@ -80,15 +84,171 @@ enum class Record {
 // Get the record type for a line.
 static Record get_record(const std::string& line);
 
+/// Parse the floating point value in the fixed-width field starting at
+/// `line[start]`, without allocating a substring
+static double read_float_field(const std::string& line, size_t start, size_t width) {
+    if (start >= line.length()) {
+        throw format_error("can not parse number in PDB line '{}'", line);
+    }
+    // the field can be truncated by the end of the line
+    width = std::min(width, line.length() - start);
+
+    char buffer[16];
+    assert(width < sizeof(buffer));
+    std::memcpy(buffer, line.data() + start, width);
+    buffer[width] = '\0';
+
+    char* stop = nullptr;
+    double value = std::strtod(buffer, &stop);
+    while (*stop == ' ' || *stop == '\t') {
+        stop++;
+    }
+    if (stop == buffer || *stop != '\0') {
+        throw format_error("can not parse number in PDB line '{}'", line);
+    }
+    return value;
+}
+
+/// Parse the integer in the fixed-width field starting at `line[start]`,
+/// reading the digits directly instead of going through strtoll. Failures
+/// are reported through the return value instead of an exception, since
+/// some of these fields are optional and legitimately left blank in a lot
+/// of files: throwing would sit on the path taken for every atom there.
+static bool try_read_integer_field(const std::string& line, size_t start, size_t width, long long& value) {
+    if (start >= line.length()) {
+        return false;
+    }
+    // the field can be truncated by the end of the line
+    auto it = line.data() + start;
+    auto end = it + std::min(width, line.length() - start);
+
+    while (it < end && (*it == ' ' || *it == '\t')) {
+        it++;
+    }
+    bool negative = false;
+    if (it < end && (*it == '-' || *it == '+')) {
+        negative = (*it == '-');
+        it++;
+    }
+    value = 0;
+    size_t digits = 0;
+    while (it < end && *it >= '0' && *it <= '9') {
+        value = 10 * value + (*it - '0');
+        it++;
+        digits++;
+    }
+    while (it < end && (*it == ' ' || *it == '\t')) {
+        it++;
+    }
+    if (digits == 0 || it != end) {
+        return false;
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
+/// Same as `try_read_integer_field`, for mandatory fields: throw a
+/// `FormatError` when the field is not a valid integer
+static long long read_integer_field(const std::string& line, size_t start, size_t width) {
+    long long value = 0;
+    if (!try_read_integer_field(line, start, width, value)) {
+        throw format_error("can not parse integer in PDB line '{}'", line);
+    }
+    return value;
+}
+
+/// Parse one of the 8-characters wide coordinate fields of an ATOM record.
+/// Coordinates are written in fixed-point `%8.3f` format, so the usual case
+/// is parsed with a single digit loop accumulating an integer mantissa,
+/// which is much faster than strtod and gives the same correctly rounded
+/// value. Anything not matching this layout falls back to
+/// `read_float_field`.
+static double read_coordinate_field(const std::string& line, size_t start) {
+    if (start + 8 > line.length()) {
+        return read_float_field(line, start, 8);
+    }
+    auto it = line.data() + start;
+    auto end = it + 8;
+
+    while (it < end && *it == ' ') {
+        it++;
+    }
+    bool negative = false;
+    if (it < end && *it == '-') {
+        negative = true;
+        it++;
+    }
+    int64_t mantissa = 0;
+    size_t digits = 0;
+    while (it < end && *it >= '0' && *it <= '9') {
+        mantissa = 10 * mantissa + (*it - '0');
+        it++;
+        digits++;
+    }
+    size_t decimals = 0;
+    if (it < end && *it == '.') {
+        it++;
+        while (it < end && *it >= '0' && *it <= '9') {
+            mantissa = 10 * mantissa + (*it - '0');
+            it++;
+            decimals++;
+            digits++;
+        }
+    }
+    if (digits == 0 || it != end) {
+        // unusual layout (exponent, trailing spaces, garbage, ...): let the
+        // generic parser deal with it, including the error reporting
+        return read_float_field(line, start, 8);
+    }
+
+    static const double SCALES[] = {1.0, 10.0, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7};
+    double value = static_cast<double>(mantissa) / SCALES[decimals];
+    return negative ? -value : value;
+}
+
+/// Get the content of the fixed-width field starting at `line[start]`, with
+/// the surrounding whitespace removed. The field is truncated at the end of
+/// the line if needed.
+static std::string read_string_field(const std::string& line, size_t start, size_t width) {
+    auto begin = line.data() + start;
+    auto end = begin + std::min(width, line.length() - start);
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        begin++;
+    }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    return std::string(begin, end);
+}
+
 void PDBFormat::read_next(Frame& frame) {
     frame.resize(0);
     residues_.clear();
     atom_offsets_.clear();
+    pdb_id_map_.clear();
+
+    if (natoms_hint_) {
+        // the atom count was recorded while scanning the file, use it to
+        // pre-allocate the storage filled by `read_ATOM`
+        auto natoms = *natoms_hint_;
+        frame.reserve(natoms);
+        // Rough estimate of the number of residues, to pre-allocate the
+        // storage before the per-atom loop
+        residues_.reserve(natoms / 8);
+    }
 
     std::streampos position;
     bool got_end = false;
+    // TITLE records are accumulated here and set as the frame name once the
+    // whole frame is read, instead of growing the property for every line
+    std::string title;
+    // Reuse the same line buffer for all the records of the frame instead
+    // of allocating a fresh string for every line
+    std::string line;
     while (!got_end && !file_->eof()) {
-        auto line = file_->readline();
+        file_->readline(line);
         auto record = get_record(line);
         switch (record) {
         case Record::HEADER:
@@ -99,9 +259,12 @@ void PDBFormat::read_next(Frame& frame) {
             continue;
         case Record::TITLE:
             if (line.size() < 11) {continue;}
-            frame.set("name", trim(
-                      frame.get<Property::STRING>("name").value_or("") +
-                      line.substr(10, 70)));
+            title.append(line, 10, 70);
+            // remove the trailing padding right away, so that lines padded
+            // to 80 columns do not leave runs of spaces inside the title
+            while (!title.empty() && std::isspace(static_cast<unsigned char>(title.back())) != 0) {
+                title.pop_back();
+            }
             continue;
         case Record::CRYST1:
             read_CRYST1(frame, line);
@@ -122,7 +285,7 @@ void PDBFormat::read_next(Frame& frame) {
             // Check if the next record is an `END` record
             if (!file_->eof()) {
                 position = file_->tellg();
-                line = file_->readline();
+                file_->readline(line);
                 file_->seekg(position);
                 if (get_record(line) == Record::END) {
                     // If this is the case, wait for this next record
@@ -144,7 +307,7 @@ void PDBFormat::read_next(Frame& frame) {
         case Record::TER:
             if (line.size() >= 12) {
                 try {
-                    atom_offsets_.push_back(parse<size_t>(line.substr(6, 5)));
+                    atom_offsets_.push_back(static_cast<size_t>(read_integer_field(line, 6, 5)));
                 } catch (const Error&) {
                     warning("PDB reader", "TER record not numeric: {}", line);
                 }
@@ -169,6 +332,10 @@ void PDBFormat::read_next(Frame& frame) {
         warning("PDB reader", "missing END record in file");
     }
 
+    if (!title.empty()) {
+        frame.set("name", trim(title));
+    }
+
     chain_ended(frame);
     link_standard_residue_bonds(frame);
 }
@@ -179,12 +346,12 @@ void PDBFormat::read_CRYST1(Frame& frame, const std::string& line) {
         throw format_error("CRYST1 record '{}' is too small", line);
     }
     try {
-        auto a = parse<double>(line.substr(6, 9));
-        auto b = parse<double>(line.substr(15, 9));
-        auto c = parse<double>(line.substr(24, 9));
-        auto alpha = parse<double>(line.substr(33, 7));
-        auto beta = parse<double>(line.substr(40, 7));
-        auto gamma = parse<double>(line.substr(47, 7));
+        auto a = read_float_field(line, 6, 9);
+        auto b = read_float_field(line, 15, 9);
+        auto c = read_float_field(line, 24, 9);
+        auto alpha = read_float_field(line, 33, 7);
+        auto beta = read_float_field(line, 40, 7);
+        auto gamma = read_float_field(line, 47, 7);
         auto cell = UnitCell(a, b, c, alpha, beta, gamma);
 
         frame.set_cell(cell);
@@ -193,7 +360,7 @@ void PDBFormat::read_CRYST1(Frame& frame, const std::string& line) {
     }
 
     if (line.length() >= 55) {
-        auto space_group = trim(line.substr(55, 10));
+        auto space_group = read_string_field(line, 55, 10);
         if (space_group != "P 1" && space_group != "P1") {
             warning("PDB reader", "ignoring custom space group ({}), using P1 instead", space_group);
         }
@@ -214,8 +381,8 @@ void PDBFormat::read_HELIX(const std::string& line) {
     auto inscode2 = line[37];
 
     try {
-        start = parse<size_t>(line.substr(21, 4));
-        end = parse<size_t>(line.substr(33, 4));
+        start = static_cast<size_t>(read_integer_field(line, 21, 4));
+        end = static_cast<size_t>(read_integer_field(line, 33, 4));
     } catch (const Error&) {
         warning("PDB reader", "HELIX record contains invalid numbers: '{}'", line);
         return;
@@ -229,12 +396,12 @@ void PDBFormat::read_HELIX(const std::string& line) {
     // Convert the code as a character to its numeric meaning.
     // See http://www.wwpdb.org/documentation/file-format-content/format23/sect5.html
     // for definitions of these numbers
-    auto start_info = std::make_tuple(chain1, start, inscode1);
-    auto end_info = std::make_tuple(chain2, end, inscode2);
+    auto start_info = encode_residue_info(chain1, start, inscode1);
+    auto end_info = encode_residue_info(chain2, end, inscode2);
 
     size_t helix_type = 0;
     try {
-        helix_type = parse<size_t>(line.substr(38,2));
+        helix_type = static_cast<size_t>(read_integer_field(line, 38, 2));
     } catch (const Error&) {
         warning("PDB reader", "could not parse helix type");
         return;
@@ -243,21 +410,21 @@ void PDBFormat::read_HELIX(const std::string& line) {
     switch (helix_type) {
     case 1: // Treat right and left handed helixes the same.
     case 6:
-        secinfo_.emplace_back(std::make_tuple(start_info, end_info, "alpha helix"));
+        secinfo_.emplace_back(std::make_tuple(start_info, end_info, Secondary::ALPHA_HELIX));
         break;
     case 2:
     case 7:
-        secinfo_.emplace_back(std::make_tuple(start_info, end_info, "omega helix"));
+        secinfo_.emplace_back(std::make_tuple(start_info, end_info, Secondary::OMEGA_HELIX));
         break;
     case 3:
-        secinfo_.emplace_back(std::make_tuple(start_info, end_info, "pi helix"));
+        secinfo_.emplace_back(std::make_tuple(start_info, end_info, Secondary::PI_HELIX));
         break;
     case 4:
     case 8:
-        secinfo_.emplace_back(std::make_tuple(start_info, end_info, "gamma helix"));
+        secinfo_.emplace_back(std::make_tuple(start_info, end_info, Secondary::GAMMA_HELIX));
         break;
     case 5:
-        secinfo_.emplace_back(std::make_tuple(start_info, end_info, "3-10 helix"));
+        secinfo_.emplace_back(std::make_tuple(start_info, end_info, Secondary::HELIX_3_10));
         break;
     default:
         break;
@@ -283,8 +450,8 @@ void PDBFormat::read_secondary(const std::string& line, size_t i1, size_t i2,
     size_t resid1 = 0;
     size_t resid2 = 0;
     try {
-        resid1 = parse<size_t>(line.substr(i1 + 1, 4));
-        resid2 = parse<size_t>(line.substr(i2 + 1, 4));
+        resid1 = static_cast<size_t>(read_integer_field(line, i1 + 1, 4));
+        resid2 = static_cast<size_t>(read_integer_field(line, i2 + 1, 4));
     } catch (const Error&) {
         warning("PDB reader",
             "error parsing line: '{}', check {} and {}",
@@ -296,10 +463,10 @@ void PDBFormat::read_secondary(const std::string& line, size_t i1, size_t i2,
     auto inscode1 = line[i1 + 5];
     auto inscode2 = line[i2 + 5];
 
-    auto start = std::make_tuple(chain1, resid1, inscode1);
-    auto end = std::make_tuple(chain2, resid2, inscode2);
+    auto start = encode_residue_info(chain1, resid1, inscode1);
+    auto end = encode_residue_info(chain2, resid2, inscode2);
 
-    secinfo_.emplace_back(std::make_tuple(start, end, "extended"));
+    secinfo_.emplace_back(std::make_tuple(start, end, Secondary::EXTENDED));
 }
 
 void PDBFormat::read_ATOM(Frame& frame, const std::string& line,
@@ -314,7 +481,7 @@ void PDBFormat::read_ATOM(Frame& frame, const std::string& line,
 
     if (atom_offsets_.empty()) {
         try {
-            auto initial_offset = parse<long long>(trim(line.substr(6, 5)));
+            auto initial_offset = read_integer_field(line, 6, 5);
             // We need to handle negative numbers ourselves: https://ideone.com/RdINqa
             if (initial_offset <= 0) {
                 warning("PDB reader", "{} is too small, assuming id is '1'", initial_offset);
@@ -330,21 +497,21 @@ void PDBFormat::read_ATOM(Frame& frame, const std::string& line,
 
     auto atom = (line.length() >= 78)?
         // Read both atom name and atom type
-        Atom(trim(line.substr(12, 4)),
-             trim(line.substr(76, 2))) :
+        Atom(read_string_field(line, 12, 4),
+             read_string_field(line, 76, 2)) :
 
         // Read just the atom name and hope for the best.
-        Atom(trim(line.substr(12, 4)));
+        Atom(read_string_field(line, 12, 4));
 
-    auto altloc = line.substr(16, 1);
-    if (altloc != " ") {
-        atom.set("altloc", altloc);
+    auto altloc = line[16];
+    if (altloc != ' ') {
+        atom.set("altloc", std::string(1, altloc));
     }
 
     try {
-        auto x = parse<double>(trim(line.substr(30, 8)));
-        auto y = parse<double>(trim(line.substr(38, 8)));
-        auto z = parse<double>(trim(line.substr(46, 8)));
+        auto x = read_coordinate_field(line, 30);
+        auto y = read_coordinate_field(line, 38);
+        auto z = read_coordinate_field(line, 46);
 
         frame.add_atom(std::move(atom), Vector3D(x, y, z));
     } catch (const Error&) {
@@ -352,39 +519,78 @@ void PDBFormat::read_ATOM(Frame& frame, const std::string& line,
     }
 
     auto atom_id = frame.size() - 1;
+
+    // Remember the PDB id of this atom so that CONECT records can resolve
+    // it without searching the atom offsets. Unreadable ids are resolved
+    // through atom_offsets_ instead.
+    long long pdb_id = 0;
+    if (try_read_integer_field(line, 6, 5, pdb_id) && pdb_id >= 0) {
+        auto id = static_cast<size_t>(pdb_id);
+        if (id >= pdb_id_map_.size()) {
+            pdb_id_map_.resize(id + 1, static_cast<size_t>(-1));
+        }
+        pdb_id_map_[id] = atom_id;
+    }
+
     auto insertion_code = line[26];
-    try {
-        auto resid = parse<size_t>(line.substr(22, 4));
+    // A blank or invalid residue id means there is no residue information
+    // for this atom
+    long long resid_value = 0;
+    if (try_read_integer_field(line, 22, 4, resid_value) && resid_value >= 0) {
+        auto resid = static_cast<size_t>(resid_value);
         auto chain = line[21];
-        auto complete_residue_id = std::make_tuple(chain,resid,insertion_code);
-        if (residues_.find(complete_residue_id) == residues_.end()) {
-            auto name = trim(line.substr(17, 3));
+        auto complete_residue_id = encode_residue_info(chain, resid, insertion_code);
+        auto make_residue = [&]() {
+            auto name = read_string_field(line, 17, 3);
             Residue residue(std::move(name), resid);
             residue.add_atom(atom_id);
 
             if (insertion_code != ' ') {
-                residue.set("insertion_code", line.substr(26, 1));
+                residue.set("insertion_code", std::string(1, insertion_code));
             }
 
             // Set whether or not the residue is standardized
             residue.set("is_standard_pdb", !is_hetatm);
-            // This will be save as a string... on purpose to match MMTF
-            residue.set("chainid", line.substr(21, 1));
-            // PDB format makes no distinction between chainid and chainname
-            residue.set("chainname", line.substr(21, 1));
-            residues_.insert({complete_residue_id, residue});
+            // This will be save as a string... on purpose to match MMTF.
+            // The chain string is built once and shared by both properties,
+            // since PDB format makes no distinction between chainid and
+            // chainname
+            auto chain_string = Property(std::string(1, chain));
+            residue.set("chainid", chain_string);
+            residue.set("chainname", std::move(chain_string));
+            return residue;
+        };
+
+        if (!residues_.empty() && residues_.back().first == complete_residue_id) {
+            // Fast path: this atom is in the same residue as the previous one
+            residues_.back().second.add_atom(atom_id);
+        } else if (residues_.empty() || residues_.back().first < complete_residue_id) {
+            residues_.emplace_back(complete_residue_id, make_residue());
         } else {
-            // Just add this atom to the residue
-            residues_.at(complete_residue_id).add_atom(atom_id);
+            // Out of order residue, find where it belongs to keep the list
+            // sorted
+            auto it = std::lower_bound(residues_.begin(), residues_.end(), complete_residue_id,
+                [](const std::pair<residue_info, Residue>& entry, const residue_info& id) {
+                    return entry.first < id;
+                }
+            );
+            if (it != residues_.end() && it->first == complete_residue_id) {
+                it->second.add_atom(atom_id);
+            } else {
+                residues_.insert(it, {complete_residue_id, make_residue()});
+            }
         }
-    } catch (const Error&) {
-        // No residue information
     }
 }
 
 void PDBFormat::read_CONECT(Frame& frame, const std::string& line) {
     assert(line.substr(0, 6) == "CONECT");
-    auto line_length = trim(line).length();
+    // length of the line without trailing whitespace, computed in place
+    // instead of allocating a trimmed copy
+    auto line_length = line.length();
+    while (line_length > 0 && std::isspace(static_cast<unsigned char>(line[line_length - 1])) != 0) {
+        line_length--;
+    }
 
     // Helper lambdas
     auto add_bond = [&frame, &line](size_t i, size_t j) {
@@ -400,7 +606,18 @@ void PDBFormat::read_CONECT(Frame& frame, const std::string& line) {
 
     auto read_index = [&line,this](size_t initial) -> size_t {
         try {
-            auto pdb_atom_id = parse<size_t>(line.substr(initial, 5));
+            auto value = read_integer_field(line, initial, 5);
+            if (value < 0) {
+                throw format_error("atom id is negative in '{}'", line);
+            }
+            auto pdb_atom_id = static_cast<size_t>(value);
+            // Fast path: the id was recorded while reading the atoms
+            if (pdb_atom_id < pdb_id_map_.size()) {
+                auto index = pdb_id_map_[pdb_atom_id];
+                if (index != static_cast<size_t>(-1)) {
+                    return index;
+                }
+            }
             auto lower = std::lower_bound(atom_offsets_.begin(),
                                           atom_offsets_.end(), pdb_atom_id);
             pdb_atom_id -= static_cast<size_t>(lower - atom_offsets_.begin());
@@ -442,12 +659,38 @@ void PDBFormat::read_CONECT(Frame& frame, const std::string& line) {
     }
 }
 
+const char* PDBFormat::secondary_name(Secondary kind) {
+    switch (kind) {
+    case Secondary::ALPHA_HELIX:
+        return "alpha helix";
+    case Secondary::OMEGA_HELIX:
+        return "omega helix";
+    case Secondary::PI_HELIX:
+        return "pi helix";
+    case Secondary::GAMMA_HELIX:
+        return "gamma helix";
+    case Secondary::HELIX_3_10:
+        return "3-10 helix";
+    case Secondary::EXTENDED:
+        return "extended";
+    }
+    unreachable();
+}
+
 void PDBFormat::chain_ended(Frame& frame) {
     for (const auto& secinfo: secinfo_) {
-        auto start = residues_.lower_bound(std::get<0>(secinfo));
-        auto end = residues_.upper_bound(std::get<1>(secinfo));
+        auto start = std::lower_bound(residues_.begin(), residues_.end(), std::get<0>(secinfo),
+            [](const std::pair<residue_info, Residue>& entry, const residue_info& id) {
+                return entry.first < id;
+            }
+        );
+        auto end = std::upper_bound(residues_.begin(), residues_.end(), std::get<1>(secinfo),
+            [](const residue_info& id, const std::pair<residue_info, Residue>& entry) {
+                return id < entry.first;
+            }
+        );
         for (auto residue = start; residue != end; ++residue) {
-            residue->second.set("secondary_structure", std::get<2>(secinfo));
+            residue->second.set("secondary_structure", secondary_name(std::get<2>(secinfo)));
         }
     }
 
@@ -462,25 +705,88 @@ void PDBFormat::chain_ended(Frame& frame) {
     residues_.clear();
 }
 
+/// Pack an atom name of up to four characters into an integer, so that the
+/// per-residue name lookups in `link_standard_residue_bonds` are integer
+/// comparisons instead of heap-allocated string comparisons. Longer names can
+/// not appear in the standard connectivity table, and map to the unused 0.
+static uint32_t pack_atom_name(const std::string& name) {
+    if (name.empty() || name.length() > 4) {
+        return 0;
+    }
+    uint32_t code = 0;
+    for (auto c: name) {
+        code = (code << 8) | static_cast<unsigned char>(c);
+    }
+    return code;
+}
+
+/// Find the atom called `name` in the sorted `(packed name, atom index)`
+/// list built by `link_standard_residue_bonds`. When a residue contains
+/// multiple atoms with the same name (e.g. alternate locations), the one
+/// with the highest index is returned.
+static optional<size_t> find_atom(
+    const std::vector<std::pair<uint32_t, size_t>>& atom_names,
+    const std::string& name
+) {
+    auto code = pack_atom_name(name);
+    auto it = std::upper_bound(
+        atom_names.begin(), atom_names.end(), std::make_pair(code, SIZE_MAX)
+    );
+    if (it != atom_names.begin() && (it - 1)->first == code) {
+        return (it - 1)->second;
+    }
+    return nullopt;
+}
+
 void PDBFormat::link_standard_residue_bonds(Frame& frame) {
     bool link_previous_peptide = false;
     bool link_previous_nucleic = false;
     uint64_t previous_residue_id = 0;
     size_t previous_carboxylic_id = 0;
 
+    // A handful of residue names covers nearly all the residues of typical
+    // files, so memoize the connectivity table lookups for this frame. The
+    // packed name is cheaper to hash and compare than the string key of the
+    // global table.
+    std::unordered_map<uint32_t, const PDBConnectivity::ResidueConnectMap*> known_residues;
+
     for (const auto& residue: frame.topology().residues()) {
-        auto residue_table = PDBConnectivity::find(residue.name());
-        if (!residue_table) {
+        const PDBConnectivity::ResidueConnectMap* residue_table = nullptr;
+        auto name_code = pack_atom_name(residue.name());
+        if (name_code != 0) {
+            auto it = known_residues.find(name_code);
+            if (it != known_residues.end()) {
+                residue_table = it->second;
+            } else {
+                auto found = PDBConnectivity::find(residue.name());
+                residue_table = found ? &*found : nullptr;
+                known_residues.emplace(name_code, residue_table);
+            }
+        } else {
+            // residue names longer than four characters are not packable,
+            // look them up directly
+            auto found = PDBConnectivity::find(residue.name());
+            residue_table = found ? &*found : nullptr;
+        }
+        if (residue_table == nullptr) {
             continue;
         }
 
-        std::map<std::string, size_t> atom_name_to_index;
+        // Residues have a few dozen atoms at most, so a sorted vector of
+        // (packed name, atom index) pairs is faster to build and search
+        // than a tree of strings
+        std::vector<std::pair<uint32_t, size_t>> atom_name_to_index;
+        atom_name_to_index.reserve(residue.size());
         for (size_t atom : residue) {
-            atom_name_to_index[frame[atom].name()] =  atom;
+            auto code = pack_atom_name(frame[atom].name());
+            if (code != 0) {
+                atom_name_to_index.emplace_back(code, atom);
+            }
         }
+        std::sort(atom_name_to_index.begin(), atom_name_to_index.end());
 
-        const auto& amide_nitrogen = atom_name_to_index.find("N");
-        const auto& amide_carbon = atom_name_to_index.find("C");
+        auto amide_nitrogen = find_atom(atom_name_to_index, "N");
+        auto amide_carbon = find_atom(atom_name_to_index, "C");
 
         if (!residue.id()) {
             warning("PDB reader", "got a residues without id, this should not happen");
@@ -489,46 +795,48 @@ void PDBFormat::link_standard_residue_bonds(Frame& frame) {
 
         auto resid = *residue.id();
         if (link_previous_peptide &&
-            amide_nitrogen != atom_name_to_index.end() &&
+            amide_nitrogen &&
             resid == previous_residue_id + 1 )
         {
             link_previous_peptide = false;
-            frame.add_bond(previous_carboxylic_id, amide_nitrogen->second);
+            frame.add_bond(previous_carboxylic_id, *amide_nitrogen);
         }
 
-        if (amide_carbon != atom_name_to_index.end() ) {
+        if (amide_carbon) {
             link_previous_peptide = true;
-            previous_carboxylic_id = amide_carbon->second;
+            previous_carboxylic_id = *amide_carbon;
             previous_residue_id = resid;
         }
 
-        const auto& three_prime_oxygen = atom_name_to_index.find("O3'");
-        const auto& five_prime_phospho = atom_name_to_index.find("P");
+        auto three_prime_oxygen = find_atom(atom_name_to_index, "O3'");
+        auto five_prime_phospho = find_atom(atom_name_to_index, "P");
 
         if (link_previous_nucleic &&
-            five_prime_phospho != atom_name_to_index.end() &&
+            five_prime_phospho &&
             resid == previous_residue_id + 1 )
         {
             link_previous_nucleic = false;
-            frame.add_bond(previous_carboxylic_id, three_prime_oxygen->second);
+            frame.add_bond(previous_carboxylic_id, *three_prime_oxygen);
         }
 
-        if (three_prime_oxygen != atom_name_to_index.end() ) {
+        if (three_prime_oxygen) {
             link_previous_nucleic = true;
-            previous_carboxylic_id = three_prime_oxygen->second;
+            previous_carboxylic_id = *three_prime_oxygen;
             previous_residue_id = resid;
         }
 
         // A special case missed by the standards committee????
-        if (atom_name_to_index.count("HO5'") != 0) {
-            frame.add_bond(atom_name_to_index["HO5'"], atom_name_to_index["O5'"]);
+        auto ho5_hydrogen = find_atom(atom_name_to_index, "HO5'");
+        auto five_prime_oxygen = find_atom(atom_name_to_index, "O5'");
+        if (ho5_hydrogen && five_prime_oxygen) {
+            frame.add_bond(*ho5_hydrogen, *five_prime_oxygen);
         }
 
         for (const auto& link: *residue_table) {
-            const auto& first_atom = atom_name_to_index.find(link.first);
-            const auto& second_atom = atom_name_to_index.find(link.second);
+            auto first_atom = find_atom(atom_name_to_index, link.first);
+            auto second_atom = find_atom(atom_name_to_index, link.second);
 
-            if (first_atom == atom_name_to_index.end()) {
+            if (!first_atom) {
                 const auto& first_name = link.first.string();
                 if (first_name[0] != 'H' && first_name != "OXT" &&
                     first_name[0] != 'P' && first_name.substr(0, 2) != "OP" ) {
@@ -540,7 +848,7 @@ void PDBFormat::link_standard_residue_bonds(Frame& frame) {
                 continue;
             }
 
-            if (second_atom == atom_name_to_index.end()) {
+            if (!second_atom) {
                 const auto& second_name = link.second.string();
                 if (second_name[0] != 'H' && second_name != "OXT" &&
                     second_name[0] != 'P' && second_name.substr(0, 2) != "OP" ) {
@@ -552,53 +860,81 @@ void PDBFormat::link_standard_residue_bonds(Frame& frame) {
                 continue;
             }
 
-            frame.add_bond(first_atom->second, second_atom->second);
+            frame.add_bond(*first_atom, *second_atom);
         }
     }
 }
 
+/// Pack the first six characters of a record name into an integer, so
+/// that the record dispatch below is a single integer comparison instead
+/// of a string comparison. `name` must contain at least 6 characters.
+static constexpr uint64_t record_code(const char* name) {
+    return (static_cast<uint64_t>(static_cast<unsigned char>(name[0])) << 40) |
+           (static_cast<uint64_t>(static_cast<unsigned char>(name[1])) << 32) |
+           (static_cast<uint64_t>(static_cast<unsigned char>(name[2])) << 24) |
+           (static_cast<uint64_t>(static_cast<unsigned char>(name[3])) << 16) |
+           (static_cast<uint64_t>(static_cast<unsigned char>(name[4])) << 8) |
+            static_cast<uint64_t>(static_cast<unsigned char>(name[5]));
+}
+
 Record get_record(const std::string& line) {
-    auto rec = line.substr(0, 6);
-    if(rec == "ENDMDL") {
+    // lines shorter than 6 characters are padded with zero bytes, which
+    // can not match any of the exact record codes below
+    uint64_t code = 0;
+    auto length = std::min<size_t>(line.length(), 6);
+    for (size_t i=0; i<length; i++) {
+        code |= static_cast<uint64_t>(static_cast<unsigned char>(line[i])) << (40 - 8 * i);
+    }
+
+    switch (code) {
+    case record_code("ENDMDL"):
         return Record::ENDMDL;
-    } else if(rec.substr(0, 3) == "END") {
-        // Handle missing whitespace in END record
-        return Record::END;
-    } else if (rec == "CRYST1") {
+    case record_code("CRYST1"):
         return Record::CRYST1;
-    } else if (rec == "ATOM  ") {
+    case record_code("ATOM  "):
         return Record::ATOM;
-    } else if (rec == "HETATM") {
+    case record_code("HETATM"):
         return Record::HETATM;
-    } else if (rec == "CONECT") {
+    case record_code("CONECT"):
         return Record::CONECT;
-    } else if (rec.substr(0, 5) == "MODEL") {
-        return Record::MODEL;
-    } else if (rec.substr(0, 3) == "TER") {
-        return Record::TER;
-    } else if (rec == "HELIX ") {
+    case record_code("HELIX "):
         return Record::HELIX;
-    } else if (rec == "SHEET ") {
+    case record_code("SHEET "):
         return Record::SHEET;
-    } else if (rec == "TURN  ") {
+    case record_code("TURN  "):
         return Record::TURN;
-    } else if (rec == "HEADER") { // These appear the least, so check last
+    case record_code("HEADER"): // These appear the least, so check last
         return Record::HEADER;
-    } else if (rec == "TITLE ") {
+    case record_code("TITLE "):
         return Record::TITLE;
-    } else if (rec == "REMARK" || rec == "MASTER" || rec == "AUTHOR" ||
-               rec == "CAVEAT" || rec == "COMPND" || rec == "EXPDTA" ||
-               rec == "KEYWDS" || rec == "OBSLTE" || rec == "SOURCE" ||
-               rec == "SPLIT " || rec == "SPRSDE" || rec == "JRNL  " ||
-               rec == "SEQRES" || rec == "HET   " || rec == "REVDAT" ||
-               rec == "SCALE1" || rec == "SCALE2" || rec == "SCALE3" ||
-               rec == "ORIGX1" || rec == "ORIGX2" || rec == "ORIGX3" ||
-               rec == "SCALE1" || rec == "SCALE2" || rec == "SCALE3" ||
-               rec == "ANISOU" || rec == "SITE  " || rec == "FORMUL" ||
-               rec == "DBREF " || rec == "HETNAM" || rec == "HETSYN" ||
-               rec == "SSBOND" || rec == "LINK  " || rec == "SEQADV" ||
-               rec == "MODRES" || rec == "SEQRES" || rec == "CISPEP") {
+    case record_code("REMARK"): case record_code("MASTER"):
+    case record_code("AUTHOR"): case record_code("CAVEAT"):
+    case record_code("COMPND"): case record_code("EXPDTA"):
+    case record_code("KEYWDS"): case record_code("OBSLTE"):
+    case record_code("SOURCE"): case record_code("SPLIT "):
+    case record_code("SPRSDE"): case record_code("JRNL  "):
+    case record_code("SEQRES"): case record_code("HET   "):
+    case record_code("REVDAT"): case record_code("SCALE1"):
+    case record_code("SCALE2"): case record_code("SCALE3"):
+    case record_code("ORIGX1"): case record_code("ORIGX2"):
+    case record_code("ORIGX3"): case record_code("ANISOU"):
+    case record_code("SITE  "): case record_code("FORMUL"):
+    case record_code("DBREF "): case record_code("HETNAM"):
+    case record_code("HETSYN"): case record_code("SSBOND"):
+    case record_code("LINK  "): case record_code("SEQADV"):
+    case record_code("MODRES"): case record_code("CISPEP"):
         return Record::IGNORED_;
+    default:
+        break;
+    }
+
+    // Records with missing trailing whitespace are matched on their prefix
+    if ((code >> 24) == (record_code("END   ") >> 24)) {
+        return Record::END;
+    } else if ((code >> 8) == (record_code("MODEL ") >> 8)) {
+        return Record::MODEL;
+    } else if ((code >> 24) == (record_code("TER   ") >> 24)) {
+        return Record::TER;
     } else if (trim(line).empty()) {
         return Record::IGNORED_;
     } else {
@@ -622,12 +958,19 @@ static std::string to_pdb_index(uint64_t i) {
 
 void PDBFormat::write_next(const Frame& frame) {
     written_ = true;
-    fmt::print(*file_, "MODEL {:>4}\n", models_ + 1);
+
+    // Assemble the whole frame in memory and send it to the file with a
+    // single write call, instead of one call per record. ATOM lines are 81
+    // bytes long, and every bond adds two entries to the CONECT records.
+    auto buffer = fmt::memory_buffer();
+    buffer.reserve(81 * frame.size() + 16 * frame.topology().bonds().size() + 128);
+
+    fmt::format_to(buffer, "MODEL {:>4}\n", models_ + 1);
 
     auto& cell = frame.cell();
     check_values_size(Vector3D(cell.a(), cell.b(), cell.c()), 9, "cell lengths");
-    fmt::print(
-        *file_,
+    fmt::format_to(
+        buffer,
         // Do not try to guess the space group and the z value, just use the
         // default one.
         "CRYST1{:9.3f}{:9.3f}{:9.3f}{:7.2f}{:7.2f}{:7.2f} P 1           1\n",
@@ -724,46 +1067,64 @@ void PDBFormat::write_next(const Frame& frame) {
         auto& pos = positions[i];
         check_values_size(pos, 8, "atomic position");
 
-        fmt::print(
-            *file_,
+        fmt::format_to(
+            buffer,
             "{: <6}{: >5} {: <4s}{:1}{:3} {:1}{: >4s}{:1}   {:8.3f}{:8.3f}{:8.3f}{:6.2f}{:6.2f}          {: >2s}\n",
             atom_hetatm, to_pdb_index(i), frame[i].name(), altloc, resname, chainid, resid, inscode, pos[0], pos[1], pos[2], 1.0, 0.0, frame[i].type()
         );
     }
 
-    auto connect = std::vector<std::vector<size_t>>(frame.size());
-    for (auto& bond : frame.topology().bonds()) {
+    // Flat (atom, neighbor) adjacency list in a single allocation, instead
+    // of one heap-allocated vector per atom. The bond list is ordered, so
+    // sorting the pairs gives every atom its neighbors in increasing order.
+    auto& bonds = frame.topology().bonds();
+    std::vector<std::pair<size_t, size_t>> connect;
+    connect.reserve(2 * bonds.size());
+    for (auto& bond : bonds) {
         if (bond[0] > 99999 || bond[1] > 99999) {
             warning("PDB writer", "atomic index is too big for CONNECT, removing the bond between {} and {}", bond[0], bond[1]);
             continue;
         }
-        connect[bond[0]].push_back(bond[1]);
-        connect[bond[1]].push_back(bond[0]);
+        connect.emplace_back(bond[0], bond[1]);
+        connect.emplace_back(bond[1], bond[0]);
     }
+    std::sort(connect.begin(), connect.end());
+
+    size_t position = 0;
+    while (position < connect.size()) {
+        auto atom = connect[position].first;
+        auto run_end = position;
+        while (run_end < connect.size() && connect[run_end].first == atom) {
+            run_end++;
+        }
 
-    for (size_t i = 0; i < frame.size(); i++) {
-        auto connections = connect[i].size();
-        auto lines = connections / 4 + 1;
-        if (connections == 0) {continue;}
-
-        for (size_t conect_line = 0; conect_line < lines; conect_line++) {
-            fmt::print(*file_, "CONECT{: >5}", to_pdb_index(i));
-            auto last = std::min(connections, 4 * (conect_line + 1));
-            for (size_t j = 4 * conect_line; j < last; j++) {
-                fmt::print(*file_, "{: >5}", to_pdb_index(connect[i][j]));
+        // emit the neighbors of this atom, four per CONECT line
+        for (size_t first = position; first < run_end; first += 4) {
+            fmt::format_to(buffer, "CONECT{: >5}", to_pdb_index(atom));
+            auto last = std::min(run_end, first + 4);
+            for (size_t j = first; j < last; j++) {
+                fmt::format_to(buffer, "{: >5}", to_pdb_index(connect[j].second));
             }
-            fmt::print(*file_, "\n");
+            buffer.push_back('\n');
         }
+        position = run_end;
     }
 
-    fmt::print(*file_, "ENDMDL\n");
+    fmt::format_to(buffer, "ENDMDL\n");
+    file_->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 
     models_++;
 }
 
 void check_values_size(const Vector3D& values, unsigned width, const std::string& context) {
-    double max_pos = std::pow(10.0, width) - 1;
-    double max_neg = -std::pow(10.0, width - 1) + 1;
+    // this runs once per atom when writing, and width is always a small
+    // constant: a table lookup avoids two libm pow calls per atom
+    static const double POWERS_OF_TEN[] = {
+        1.0, 10.0, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    };
+    assert(width >= 1 && width < sizeof(POWERS_OF_TEN) / sizeof(double));
+    double max_pos = POWERS_OF_TEN[width] - 1;
+    double max_neg = -POWERS_OF_TEN[width - 1] + 1;
     if (values[0] > max_pos || values[1] > max_pos || values[2] > max_pos ||
         values[0] < max_neg || values[1] < max_neg || values[2] < max_neg) {
         throw format_error(
@@ -778,16 +1139,22 @@ PDBFormat::~PDBFormat() {
     }
 }
 
-std::streampos PDBFormat::forward() {
+StepPosition PDBFormat::forward() {
     if (!*file_) {
         return std::streampos(-1);
     }
 
     auto position = file_->tellg();
+    size_t natoms = 0;
     while (true) {
         try {
             auto line = file_->readline();
 
+            if (line.compare(0, 6, "ATOM  ") == 0 || line.compare(0, 6, "HETATM") == 0) {
+                natoms++;
+                continue;
+            }
+
             if (line.substr(0, 6) == "ENDMDL") {
                 auto save = file_->tellg();
                 auto next = file_->readline();
@@ -800,16 +1167,34 @@ std::streampos PDBFormat::forward() {
             }
 
             if (line.substr(0, 3) == "END") {
-                return position;
+                return {position, natoms};
             }
 
         } catch (const FileError&) {
             // Handle missing END record
             if (position == std::streampos(0)) {
-                return position;
+                return {position, natoms};
             } else {
                 return std::streampos(-1);
             }
         }
     }
 }
+
+bool PDBFormat::can_parallelize_scan() const {
+    // The parallel scan recognizes steps by their MODEL record, which
+    // matches the serial forward() only when the file itself starts with a
+    // MODEL record, as trajectory-like multi-model files do. Files with
+    // header records before the first MODEL keep the serial scan, since
+    // their first step starts at the top of the file.
+    auto mapped = dynamic_cast<const MemoryMappedFile*>(file_.get());
+    return mapped != nullptr && mapped->size() >= 6 &&
+           std::memcmp(mapped->data(), "MODEL ", 6) == 0;
+}
+
+bool PDBFormat::can_split_at(const char* data, size_t length) const {
+    // A new step starts on the MODEL record following the ENDMDL of the
+    // previous one
+    return length >= 6 && std::memcmp(data, "MODEL", 5) == 0 &&
+           (data[5] == ' ' || data[5] == '\r' || data[5] == '\n');
+}
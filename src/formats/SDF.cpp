@@ -3,16 +3,20 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <array>
 #include <string>
 #include <vector>
 #include <memory>
 #include <sstream>
+#include <algorithm>
 #include <exception>
 
 #include <fmt/ostream.h>
 
 #include "chemfiles/File.hpp"
+#include "chemfiles/files/MemoryMappedFile.hpp"
 #include "chemfiles/Format.hpp"
 #include "chemfiles/Atom.hpp"
 #include "chemfiles/Frame.hpp"
@@ -36,6 +40,141 @@ template<> FormatInfo chemfiles::format_information<SDFFormat>() {
     );
 }
 
+/// Parse the floating point value in the fixed-width field starting at
+/// `line[start]`, without allocating a substring
+static double read_float_field(const std::string& line, size_t start, size_t width) {
+    if (start >= line.length()) {
+        throw format_error("can not parse number in SDF line '{}'", line);
+    }
+    // the field can be truncated by the end of the line
+    width = std::min(width, line.length() - start);
+
+    char buffer[16];
+    assert(width < sizeof(buffer));
+    std::memcpy(buffer, line.data() + start, width);
+    buffer[width] = '\0';
+
+    char* stop = nullptr;
+    double value = std::strtod(buffer, &stop);
+    while (*stop == ' ' || *stop == '\t') {
+        stop++;
+    }
+    if (stop == buffer || *stop != '\0') {
+        throw format_error("can not parse number in SDF line '{}'", line);
+    }
+    return value;
+}
+
+/// Parse the fixed-point coordinate in the 10-characters wide field starting
+/// at `line[start]`. SDF coordinates are always written as plain fixed-point
+/// values (`"   -1.2345"`), which a single pass over the digits can parse
+/// exactly; any other layout falls back to the generic parser.
+static double read_coordinate_field(const std::string& line, size_t start) {
+    if (start + 10 > line.length()) {
+        return read_float_field(line, start, 10);
+    }
+    auto it = line.data() + start;
+    auto end = it + 10;
+
+    while (it < end && *it == ' ') {
+        it++;
+    }
+    bool negative = false;
+    if (it < end && *it == '-') {
+        negative = true;
+        it++;
+    }
+    int64_t mantissa = 0;
+    size_t digits = 0;
+    while (it < end && *it >= '0' && *it <= '9') {
+        mantissa = 10 * mantissa + (*it - '0');
+        it++;
+        digits++;
+    }
+    size_t decimals = 0;
+    if (it < end && *it == '.') {
+        it++;
+        while (it < end && *it >= '0' && *it <= '9') {
+            mantissa = 10 * mantissa + (*it - '0');
+            it++;
+            decimals++;
+            digits++;
+        }
+    }
+    if (digits == 0 || it != end) {
+        // unusual layout (exponent, trailing spaces, garbage, ...): let the
+        // generic parser deal with it, including the error reporting
+        return read_float_field(line, start, 10);
+    }
+
+    static const double SCALES[] = {1.0, 10.0, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    double value = static_cast<double>(mantissa) / SCALES[decimals];
+    return negative ? -value : value;
+}
+
+/// Parse the integer in the fixed-width field starting at `line[start]`,
+/// reading the digits directly instead of going through strtoll. Failures
+/// are reported through the return value, for the fields where they only
+/// warrant a warning.
+static bool try_read_integer_field(const std::string& line, size_t start, size_t width, long long& value) {
+    if (start >= line.length()) {
+        return false;
+    }
+    // the field can be truncated by the end of the line
+    auto it = line.data() + start;
+    auto end = it + std::min(width, line.length() - start);
+
+    while (it < end && (*it == ' ' || *it == '\t')) {
+        it++;
+    }
+    bool negative = false;
+    if (it < end && (*it == '-' || *it == '+')) {
+        negative = (*it == '-');
+        it++;
+    }
+    value = 0;
+    size_t digits = 0;
+    while (it < end && *it >= '0' && *it <= '9') {
+        value = 10 * value + (*it - '0');
+        it++;
+        digits++;
+    }
+    while (it < end && (*it == ' ' || *it == '\t')) {
+        it++;
+    }
+    if (digits == 0 || it != end) {
+        return false;
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
+/// Same as `try_read_integer_field`, for mandatory fields: throw a
+/// `FormatError` when the field is not a valid integer
+static long long read_integer_field(const std::string& line, size_t start, size_t width) {
+    long long value = 0;
+    if (!try_read_integer_field(line, start, width, value)) {
+        throw format_error("can not parse integer in SDF line '{}'", line);
+    }
+    return value;
+}
+
+/// Get the content of the fixed-width field starting at `line[start]`, with
+/// the surrounding whitespace removed
+static std::string read_string_field(const std::string& line, size_t start, size_t width) {
+    auto begin = line.data() + start;
+    auto end = begin + std::min(width, line.length() - start);
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        begin++;
+    }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    return std::string(begin, end);
+}
+
 void SDFFormat::read_next(Frame& frame) {
 
     // Make this global as it may contain information we need later
@@ -50,65 +189,51 @@ void SDFFormat::read_next(Frame& frame) {
         file_->skipline(); // Comment line - skip it
 
         counts_line = file_->readline();
-        natoms = parse<size_t>(counts_line.substr(0, 3));
-        nbonds = parse<size_t>(counts_line.substr(3, 3));
+        natoms = static_cast<size_t>(read_integer_field(counts_line, 0, 3));
+        nbonds = static_cast<size_t>(read_integer_field(counts_line, 3, 3));
     } catch (const std::exception& e) {
         throw format_error("can not read next step as SDF: {}", e.what());
     }
 
-    std::vector<std::string> atom_lines;
-    try {
-        atom_lines = file_->readlines(natoms);
-    } catch (const FileError& e) {
-        throw format_error("can not read file: {}", e.what());
-    }
-
     frame.reserve(natoms);
     frame.resize(0);
 
-    for (const auto& line: atom_lines) {
+    // Parse the atom block as it is read, with a single reused line buffer,
+    // instead of materializing a vector with one string per atom
+    std::string line;
+    for (size_t i = 0; i < natoms; i++) {
+        try {
+            file_->readline(line);
+        } catch (const FileError& e) {
+            throw format_error("can not read file: {}", e.what());
+        }
+
         if (line.length() < 34) {
             throw format_error(
                 "atom line is too small for SDF: '{}'", line
             );
         }
 
-        auto x = parse<double>(line.substr(0, 10));
-        auto y = parse<double>(line.substr(10, 10));
-        auto z = parse<double>(line.substr(20, 10));
-        auto name = trim(line.substr(31, 3));
+        auto x = read_coordinate_field(line, 0);
+        auto y = read_coordinate_field(line, 10);
+        auto z = read_coordinate_field(line, 20);
+        auto name = read_string_field(line, 31, 3);
 
-        auto atom = Atom(name);
+        auto atom = Atom(std::move(name));
 
         if (line.length() >= 40) {
             long long chrg = 0;
-            try {
-                chrg = parse<long long>(line.substr(36, 3));
-            } catch (const Error&) {
+            if (!try_read_integer_field(line, 36, 3, chrg)) {
                 warning("SDF reader", "charge code not numeric: {}", line.substr(36, 3));
             }
-            switch(chrg) {
-            case 0:
-                break; // do nothing
-            case 1:
-                atom.set_charge(3.0);
-                break;
-            case 2:
-                atom.set_charge(2.0);
-                break;
-            case 3:
-                atom.set_charge(1.0);
-                break;
-            case 5:
-                atom.set_charge(-1.0);
-                break;
-            case 6:
-                atom.set_charge(-2.0);
-                break;
-            case 7:
-                atom.set_charge(-3.0);
-                break;
-            default:
+            // charge code to formal charge, indexed by the code. Code 4
+            // (doublet radical) does not map to a charge.
+            static const double CODE_TO_CHARGE[] = {
+                0.0, 3.0, 2.0, 1.0, 0.0, -1.0, -2.0, -3.0,
+            };
+            if (chrg >= 0 && chrg < 8 && chrg != 4) {
+                atom.set_charge(CODE_TO_CHARGE[chrg]);
+            } else {
                 warning("SDF reader", "unknown charge code: '{}'", chrg);
             }
         }
@@ -116,40 +241,35 @@ void SDFFormat::read_next(Frame& frame) {
         frame.add_atom(std::move(atom), Vector3D(x, y, z));
     }
 
-    std::vector<std::string> bond_lines;
-    try {
-        bond_lines = file_->readlines(nbonds);
-    } catch (const FileError& e) {
-        throw format_error("can not read file: {}", e.what());
-    }
-
-    for (const auto& line: bond_lines) {
-        auto atom1 = parse<size_t>(line.substr(0, 3));
-        auto atom2 = parse<size_t>(line.substr(3, 3));
-        auto bondo = parse<size_t>(line.substr(6, 3));
+    // Same as for the atom block: parse the bond lines as they are read
+    for (size_t i = 0; i < nbonds; i++) {
+        try {
+            file_->readline(line);
+        } catch (const FileError& e) {
+            throw format_error("can not read file: {}", e.what());
+        }
 
-        Bond::BondOrder bo;
+        auto atom1 = read_integer_field(line, 0, 3);
+        auto atom2 = read_integer_field(line, 3, 3);
+        auto bondo = read_integer_field(line, 6, 3);
+        if (atom1 <= 0 || atom2 <= 0) {
+            throw format_error("invalid atom index in SDF bond line '{}'", line);
+        }
 
-        switch (bondo) {
-            case 1:
-                bo = Bond::SINGLE;
-                break;
-            case 2:
-                bo = Bond::DOUBLE;
-                break;
-            case 3:
-                bo = Bond::TRIPLE;
-                break;
-            case 4:
-                bo = Bond::AROMATIC;
-                break;
-            case 8: // The 8 ispecifically means unspecified
-            default:
-                bo = Bond::UNKNOWN;
-                break;
+        // SDF bond code to bond order, indexed by the code. The code 8
+        // specifically means unspecified, and codes without a defined
+        // order also map to UNKNOWN.
+        static const Bond::BondOrder CODE_TO_ORDER[] = {
+            Bond::UNKNOWN, Bond::SINGLE, Bond::DOUBLE, Bond::TRIPLE,
+            Bond::AROMATIC, Bond::UNKNOWN, Bond::UNKNOWN, Bond::UNKNOWN,
+            Bond::UNKNOWN,
+        };
+        auto bo = Bond::UNKNOWN;
+        if (bondo >= 0 && bondo < 9) {
+            bo = CODE_TO_ORDER[bondo];
         }
 
-        frame.add_bond(atom1 - 1, atom2 - 1, bo);
+        frame.add_bond(static_cast<size_t>(atom1) - 1, static_cast<size_t>(atom2) - 1, bo);
     }
 
     // Parsing the file is more or less complete now, but atom properties can
@@ -157,13 +277,13 @@ void SDFFormat::read_next(Frame& frame) {
     // This loop breaks when the property block ends or returns on an error
     while(true) {
         try {
-            auto line = file_->readline();
+            file_->readline(line);
             if (line.empty()) {
                 continue;
-            } else if (line.substr(0, 4) == "$$$$") {
+            } else if (line.compare(0, 4, "$$$$") == 0) {
                 // Ending block, technically wrong - but we can exit safetly
                 return;
-            } else if (line.substr(0, 6) == "M  END") {
+            } else if (line.compare(0, 6, "M  END") == 0) {
                 // Proper end of block
                 break;
             } // TODO: Add actual ATOM property parsing here.....
@@ -180,7 +300,7 @@ void SDFFormat::read_next(Frame& frame) {
     std::string property_value;
     while(true) {
         try {
-            auto line = file_->readline();
+            file_->readline(line);
             if (line.empty()) {
                 // This breaks a property group - so store now
                 if (property_name.empty()) {
@@ -188,17 +308,20 @@ void SDFFormat::read_next(Frame& frame) {
                     continue;
                 }
                 frame.set(property_name, Property(property_value));
-            } else if (line.substr(0, 4) == "$$$$") {
+            } else if (line.compare(0, 4, "$$$$") == 0) {
                 // Molecule ending block
                 return;
-            } else if (line.substr(0, 3) == "> <") {
+            } else if (line.compare(0, 3, "> <") == 0) {
                 // Get the property name
                 // It is formated like:
                 //> <NAMEGOESHERE>
                 const auto npos = line.find_last_of('>');
                 property_name = line.substr(3, npos - 3);
 
-                property_value = file_->readline();
+                file_->readline(property_value);
+                // multi-line values are appended to below: give the value
+                // room to grow without reallocating on the first lines
+                property_value.reserve(256);
             } else {
                 // Continuation of a property value
                 property_value += '\n';
@@ -212,14 +335,72 @@ void SDFFormat::read_next(Frame& frame) {
 
 }
 
+/// Append `value` to the buffer with `precision` digits after the decimal
+/// separator, right-aligned in a field of at least `width` characters.
+///
+/// SDF atom lines have fixed columns and a fixed precision, so a
+/// specialized formatter working on the scaled integer value can replace
+/// the general purpose (and much slower) floating point formatting in fmt.
+static void append_fixed(fmt::memory_buffer& buffer, double value, size_t width, unsigned precision) {
+    static const double SCALES[] = {1e0, 1e1, 1e2, 1e3, 1e4};
+    assert(precision < sizeof(SCALES) / sizeof(SCALES[0]));
+    auto t = value * SCALES[precision];
+    if (!(std::fabs(t) < 9e15) ||
+        std::fabs(t - (std::floor(t) + 0.5)) <= 8e-15 * std::fabs(t)) {
+        // Values outside the exact integer range (including infinities and
+        // NaN), and scaled values sitting within a few ulps of a rounding
+        // tie -- where the error introduced by the multiplication above
+        // could flip the rounding direction -- go through the generic
+        // formatter, so that the output matches the previous
+        // implementation.
+        fmt::format_to(buffer, "{:>{}.{}f}", value, width, precision);
+        return;
+    }
+    auto scaled = std::llround(t);
+    // small negative values round to a zero integer part, but still get a
+    // minus sign, as they do with printf %f
+    bool negative = std::signbit(value);
+    auto digits = static_cast<unsigned long long>(scaled < 0 ? -scaled : scaled);
+
+    char tmp[32];
+    char* cursor = tmp + sizeof(tmp);
+    for (unsigned i = 0; i < precision; i++) {
+        *--cursor = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    }
+    *--cursor = '.';
+    do {
+        *--cursor = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    } while (digits != 0);
+    if (negative) {
+        *--cursor = '-';
+    }
+
+    auto length = static_cast<size_t>(tmp + sizeof(tmp) - cursor);
+    for (size_t i = length; i < width; i++) {
+        buffer.push_back(' ');
+    }
+    buffer.append(cursor, tmp + sizeof(tmp));
+}
+
 void SDFFormat::write_next(const Frame& frame) {
     auto& topology = frame.topology();
     auto& positions = frame.positions();
     assert(frame.size() == topology.size());
 
-    fmt::print(*file_, "{}\n", frame.get<Property::STRING>("name").value_or("NONAME"));
-    fmt::print(*file_, " chemfiles-lib\n\n");
-    fmt::print(*file_, "{:>3}{:>3}  0     0  0  0  0  0  0999 V2000\n", frame.size(), topology.bonds().size());
+    // Assemble the whole frame in memory and send it to the file with a
+    // single write call. Atom lines are 70 bytes long, bond lines 22, and
+    // most properties fit a name and a single-line value.
+    auto buffer = fmt::memory_buffer();
+    buffer.reserve(
+        70 * frame.size() + 22 * topology.bonds().size() +
+        32 * frame.properties().size() + 256
+    );
+
+    fmt::format_to(buffer, "{}\n", frame.get<Property::STRING>("name").value_or("NONAME"));
+    fmt::format_to(buffer, " chemfiles-lib\n\n");
+    fmt::format_to(buffer, "{:>3}{:>3}  0     0  0  0  0  0  0999 V2000\n", frame.size(), topology.bonds().size());
 
     for (size_t i = 0; i < frame.size(); i++) {
         std::string type = topology[i].type();
@@ -229,105 +410,116 @@ void SDFFormat::write_next(const Frame& frame) {
         }
 
         int charge_code = 0;
-        double int_part;
-        if (std::modf(topology[i].charge(), &int_part) == 0.0) {
-            switch (static_cast<int>(int_part)) {
-            case 0:
-                break; // Do nothing
-            case 1:
-                charge_code = 3;
-                break;
-            case 2:
-                charge_code = 2;
-                break;
-            case 3:
-                charge_code = 1;
-                break;
-            case -1:
-                charge_code = 5;
-                break;
-            case -2:
-                charge_code = 6;
-                break;
-            case -3:
-                charge_code = 7;
-                break;
-            default:
-                warning("SDF writer", "charge code not availible for '{}'", int_part);
+        auto charge = topology[i].charge();
+        // comparing with the truncated value checks for a zero fractional
+        // part without the split through a pointer done by modf. NaN
+        // compares false and goes to the non-integer warning, like it did
+        // with modf.
+        if (charge == std::trunc(charge)) {
+            // formal charge to charge code, indexed by charge + 3
+            static const int CHARGE_TO_CODE[] = {7, 6, 5, 0, 3, 2, 1};
+            if (charge >= -3.0 && charge <= 3.0) {
+                charge_code = CHARGE_TO_CODE[static_cast<int>(charge) + 3];
+            } else {
+                warning("SDF writer", "charge code not availible for '{}'", charge);
             }
         } else {
-            warning("SDF writer", "charge not an integer: '{}'", topology[i].charge());
+            warning("SDF writer", "charge not an integer: '{}'", charge);
         }
 
-        fmt::print(
-            *file_, "{:>10.4f}{:>10.4f}{:>10.4f} {:3} 0{:3}  0  0  0  0  0  0  0  0  0  0\n",
-            positions[i][0], positions[i][1], positions[i][2], type, charge_code
+        append_fixed(buffer, positions[i][0], 10, 4);
+        append_fixed(buffer, positions[i][1], 10, 4);
+        append_fixed(buffer, positions[i][2], 10, 4);
+        fmt::format_to(
+            buffer, " {:3} 0{:3}  0  0  0  0  0  0  0  0  0  0\n", type, charge_code
         );
     }
 
-    for (const auto& bond : topology.bonds()) {
-
-        std::string bond_order;
-        auto bo = topology.bond_order(bond[0], bond[1]);
-
-        switch(bo) {
-            case Bond::SINGLE:
-                bond_order = "  1";
-                break;
-            case Bond::DOUBLE:
-                bond_order = "  2";
-                break;
-            case Bond::TRIPLE:
-                bond_order = "  3";
-                break;
-            case Bond::AROMATIC:
-                bond_order = "  4";
-                break;
-            case Bond::UNKNOWN:
-            default:
-                bond_order = "  8";
-                break;
+    // bond_orders() parallels bonds(), so indexing it directly replaces the
+    // search done by bond_order(i, j) for every bond
+    const auto& bonds = topology.bonds();
+    const auto& bond_orders = topology.bond_orders();
+    for (size_t i = 0; i < bonds.size(); i++) {
+        const auto& bond = bonds[i];
+        // the bond codes are string literals: no need to allocate a
+        // std::string for each bond. SINGLE, DOUBLE and TRIPLE match the
+        // SDF codes 1 to 3 directly; AROMATIC sits at the end of the enum,
+        // and every other order is written as unspecified (code 8).
+        static const char* const ORDER_TO_CODE[] = {"  8", "  1", "  2", "  3"};
+        const char* bond_order = "  8";
+        auto bo = bond_orders[i];
+        if (bo <= Bond::TRIPLE) {
+            bond_order = ORDER_TO_CODE[bo];
+        } else if (bo == Bond::AROMATIC) {
+            bond_order = "  4";
         }
 
-        fmt::print(
-            *file_, "{:>3}{:>3}{}  0  0  0  0\n",
+        fmt::format_to(
+            buffer, "{:>3}{:>3}{}  0  0  0  0\n",
             bond[0] + 1, bond[1] + 1, bond_order
         );
     }
 
-    fmt::print(*file_, "M  END\n");
+    fmt::format_to(buffer, "M  END\n");
 
     for (auto& prop : frame.properties()) {
         if (prop.first == "name") {
             continue;
         }
 
-        fmt::print(*file_, "> <{}>\n", prop.first);
-
+        // a single formatting call per property, for the name and the value
         switch(prop.second.kind()) {
         case Property::STRING:
-            fmt::print(*file_, "{}\n\n", prop.second.as_string());
+            fmt::format_to(buffer, "> <{}>\n{}\n\n", prop.first, prop.second.as_string());
             break;
         case Property::DOUBLE:
-            fmt::print(*file_, "{}\n\n", prop.second.as_double());
+            fmt::format_to(buffer, "> <{}>\n{}\n\n", prop.first, prop.second.as_double());
             break;
         case Property::BOOL:
-            fmt::print(*file_, "{}\n\n", prop.second.as_bool());
+            fmt::format_to(buffer, "> <{}>\n{}\n\n", prop.first, prop.second.as_bool());
             break;
-        case Property::VECTOR3D:
-            fmt::print(*file_, "{} {} {}\n\n",
-                prop.second.as_vector3d()[0],
-                prop.second.as_vector3d()[1],
-                prop.second.as_vector3d()[2]
-            );
+        case Property::VECTOR3D: {
+            const auto& value = prop.second.as_vector3d();
+            fmt::format_to(buffer, "> <{}>\n{} {} {}\n\n", prop.first, value[0], value[1], value[2]);
             break;
         }
+        }
     }
 
-    fmt::print(*file_, "$$$$\n");
+    fmt::format_to(buffer, "$$$$\n");
+    file_->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 }
 
-std::streampos SDFFormat::forward() {
+/// Find the first end of line marker (`\n` or `\r`) in `[current, end)`, or
+/// `end` if there is none. This mirrors the line extraction done by the
+/// memory-mapped read backend.
+static const char* find_end_of_line(const char* current, const char* end) {
+    auto length = static_cast<size_t>(end - current);
+    auto* lf = static_cast<const char*>(memchr(current, '\n', length));
+    // Limit the carriage return search to the characters before the line
+    // feed: a '\r' after it belongs to one of the next lines
+    auto limit = lf == nullptr ? length : static_cast<size_t>(lf - current);
+    auto* cr = static_cast<const char*>(memchr(current, '\r', limit));
+    if (cr != nullptr) {
+        return cr;
+    }
+    return lf == nullptr ? end : lf;
+}
+
+/// Move past the end of line marker at `eol`, treating `\r\n` as a single
+/// marker
+static const char* after_end_of_line(const char* eol, const char* end) {
+    if (eol == end) {
+        return end;
+    }
+    auto* next = eol + 1;
+    if (*eol == '\r' && next != end && *next == '\n') {
+        next++;
+    }
+    return next;
+}
+
+StepPosition SDFFormat::forward() {
     if (!*file_) {
         return std::streampos(-1);
     }
@@ -344,8 +536,8 @@ std::streampos SDFFormat::forward() {
             throw format_error("counts line must have at least 10 digits, it has {}", counts_line.length());
         }
 
-        natoms = parse<size_t>(counts_line.substr(0,3));
-        nbonds = parse<size_t>(counts_line.substr(3,3));
+        natoms = static_cast<size_t>(read_integer_field(counts_line, 0, 3));
+        nbonds = static_cast<size_t>(read_integer_field(counts_line, 3, 3));
     } catch (const FileError&) {
         // No more line left in the file
         return std::streampos(-1);
@@ -354,6 +546,56 @@ std::streampos SDFFormat::forward() {
         return std::streampos(-1);
     }
 
+    // With a memory-mapped file, skip the atom and bond blocks and search
+    // for the terminator directly in the mapped bytes, instead of going
+    // through the stream interface once per line. Indexing a multi-molecule
+    // file spends almost all of its time in this loop.
+    auto* mapped = dynamic_cast<MemoryMappedFile*>(file_.get());
+    if (mapped != nullptr) {
+        const char* begin = mapped->data();
+        const char* end = begin + mapped->size();
+        const char* current = begin + static_cast<std::streamoff>(file_->tellg());
+        bool at_eof = false;
+
+        for (size_t i = 0; i < natoms + nbonds; i++) {
+            if (current == end) {
+                if (at_eof) {
+                    throw format_error(
+                        "not enough lines in '{}' for SDF format", file_->path()
+                    );
+                }
+                at_eof = true;
+                continue;
+            }
+            auto* eol = find_end_of_line(current, end);
+            at_eof = (eol == end);
+            current = after_end_of_line(eol, end);
+        }
+
+        // Search for the ending line, comparing the bytes in place
+        while (!at_eof) {
+            if (current == end) {
+                at_eof = true;
+                break;
+            }
+            auto* eol = find_end_of_line(current, end);
+            bool found = (eol - current == 4) && memcmp(current, "$$$$", 4) == 0;
+            at_eof = (eol == end);
+            current = after_end_of_line(eol, end);
+            if (found) {
+                break;
+            }
+        }
+
+        // Move the stream to where the line-by-line scan would have left it
+        file_->clear();
+        file_->seekg(static_cast<std::streamoff>(current - begin));
+        if (at_eof) {
+            file_->setstate(std::ios::eofbit);
+        }
+        return position;
+    }
+
     try {
         file_->skiplines(natoms + nbonds);
     } catch (const FileError&) {
@@ -363,9 +605,13 @@ std::streampos SDFFormat::forward() {
         );
     }
 
-    // Search for ending character, updating the position in the file only
+    // Search for ending character, updating the position in the file only.
+    // The buffer is reused across iterations, so scanning a molecule does
+    // not allocate a string per line.
+    std::string line;
     while (!file_->eof()) {
-        if (file_->readline() == "$$$$") {
+        file_->readline(line);
+        if (line == "$$$$") {
             break;
         }
     }
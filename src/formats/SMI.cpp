@@ -729,7 +729,7 @@ void SMIFormat::write_next(const Frame& frame) {
     fmt::print(*file_, "\n");
 }
 
-std::streampos SMIFormat::forward() {
+StepPosition SMIFormat::forward() {
     if (!*file_) {
         return std::streampos(-1);
     }
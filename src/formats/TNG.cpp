@@ -215,6 +215,11 @@ void TNGFormat::read_cell(Frame& frame) {
 }
 
 void TNGFormat::read_topology(Frame& frame) {
+    if (topology_) {
+        frame.set_topology(*topology_);
+        return;
+    }
+
     auto topology = Topology();
     topology.reserve(static_cast<size_t>(natoms_));
 
@@ -279,5 +284,6 @@ void TNGFormat::read_topology(Frame& frame) {
         );
     }
 
-    frame.set_topology(topology);
+    topology_ = std::move(topology);
+    frame.set_topology(*topology_);
 }
@@ -143,7 +143,7 @@ void TinkerFormat::write_next(const Frame& frame) {
     }
 }
 
-std::streampos TinkerFormat::forward() {
+StepPosition TinkerFormat::forward() {
     if (!*file_) {
         return std::streampos(-1);
     }
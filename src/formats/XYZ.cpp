@@ -71,7 +71,7 @@ void XYZFormat::write_next(const Frame& frame) {
     }
 }
 
-std::streampos XYZFormat::forward() {
+StepPosition XYZFormat::forward() {
     if (!*file_) {
         return std::streampos(-1);
     }
@@ -1,27 +1,31 @@
 // Chemfiles, a modern library for chemistry file reading and writing
 // Copyright (C) Guillaume Fraux and contributors -- BSD license
 
+#include <memory>
 #include <string>
 #include <iostream>
 #include <functional>
 
 #include "chemfiles/misc.hpp"
-#include "chemfiles/mutex.hpp"
 #include "chemfiles/warnings.hpp"
 
 using namespace chemfiles;
 
-static mutex<warning_callback> CALLBACK = {[](const std::string& message){ // NOLINT
+// The callback is accessed through the std::shared_ptr atomic overloads: a
+// warning only needs an atomic load of the current callback instead of
+// locking a mutex, so concurrent readers never serialize on warnings, and a
+// callback replaced while in use stays alive until the last call using it
+// returns.
+static std::shared_ptr<const warning_callback> CALLBACK = std::make_shared<const warning_callback>([](const std::string& message){ // NOLINT
     // NOLINT: we don't reference cerr before it is initialized because we are in a lambda
     std::cerr << "[chemfiles] " << message << std::endl;
-}};
+});
 
 void chemfiles::set_warning_callback(warning_callback callback) {
-    auto guard = CALLBACK.lock();
-    *guard = std::move(callback);
+    std::atomic_store(&CALLBACK, std::make_shared<const warning_callback>(std::move(callback)));
 }
 
 void chemfiles::send_warning(const std::string& message) {
-    auto callback = CALLBACK.lock();
+    auto callback = std::atomic_load(&CALLBACK);
     (*callback)(message);
 }
@@ -0,0 +1,21 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+#include <catch.hpp>
+#include <chemfiles.hpp>
+using namespace chemfiles;
+
+#undef assert
+#define assert CHECK
+
+TEST_CASE() {
+    // [example]
+    auto frame = Frame();
+    frame.resize(10);
+    assert(frame.size() == 10);
+
+    // reserve_atoms removes all the atoms, and allocate memory for the
+    // requested number of atoms
+    frame.reserve_atoms(100);
+    assert(frame.size() == 0);
+    // [example]
+}
@@ -0,0 +1,131 @@
+// Chemfiles, a modern library for chemistry file reading and writing
+// Copyright (C) Guillaume Fraux and contributors -- BSD license
+
+#include <fstream>
+#include "catch.hpp"
+#include "helpers.hpp"
+#include "chemfiles/File.hpp"
+#include "chemfiles/files/MemoryMappedFile.hpp"
+#include "chemfiles/files/PlainFile.hpp"
+#include "chemfiles/Error.hpp"
+using namespace chemfiles;
+
+TEST_CASE("Read a memory-mapped text file") {
+    auto tmpfile = NamedTempPath(".dat");
+
+    std::ofstream file(tmpfile, std::ios_base::binary);
+    file << "125\nHelium as a Lennard-Jone fluid\nHe 0.49053 8.41351 0.0777257\n";
+    file.close();
+
+    MemoryMappedFile mapped(tmpfile);
+
+    std::string line = mapped.readline();
+    CHECK(line == "125");
+
+    auto lines = mapped.readlines(2);
+    REQUIRE(lines.size() == 2);
+    CHECK(lines[0] == "Helium as a Lennard-Jone fluid");
+    CHECK(lines[1] == "He 0.49053 8.41351 0.0777257");
+
+    mapped.rewind();
+    line = mapped.readline();
+    CHECK(line == "125");
+    mapped.skipline();
+    line = mapped.readline();
+    CHECK(line == "He 0.49053 8.41351 0.0777257");
+
+    CHECK_THROWS_WITH(
+        MemoryMappedFile("not existing"),
+        "could not open the file at 'not existing'"
+    );
+}
+
+TEST_CASE("Various line endinds in a memory-mapped file") {
+    auto tmpfile = NamedTempPath(".dat");
+
+    std::ofstream file(tmpfile, std::ios_base::binary);
+    file << "line one\nline two\rline three\r\nno eol";
+    file.close();
+
+    SECTION("readline") {
+        MemoryMappedFile mapped(tmpfile);
+        CHECK(mapped.readline() == "line one");
+        CHECK(mapped.readline() == "line two");
+        CHECK(mapped.readline() == "line three");
+        CHECK(mapped.readline() == "no eol");
+    }
+
+    SECTION("skipline") {
+        MemoryMappedFile mapped(tmpfile);
+        mapped.skiplines(3);
+        CHECK(mapped.readline() == "no eol");
+    }
+}
+
+TEST_CASE("Seeking in a memory-mapped file") {
+    auto tmpfile = NamedTempPath(".dat");
+
+    std::ofstream file(tmpfile, std::ios_base::binary);
+    file << "first\nsecond\nthird\n";
+    file.close();
+
+    MemoryMappedFile mapped(tmpfile);
+    CHECK(mapped.tellg() == 0);
+
+    mapped.readline();
+    CHECK(mapped.tellg() == 6);
+
+    mapped.seekg(13);
+    CHECK(mapped.readline() == "third");
+
+    mapped.rewind();
+    CHECK(mapped.tellg() == 0);
+    CHECK(mapped.readline() == "first");
+}
+
+TEST_CASE("End of a memory-mapped file") {
+    auto tmpfile = NamedTempPath(".dat");
+
+    std::ofstream file(tmpfile, std::ios_base::binary);
+    file << "first\nlast line";
+    file.close();
+
+    MemoryMappedFile mapped(tmpfile);
+    CHECK(mapped.readline() == "first");
+    // the last line has no end of line marker, but still reads fine
+    CHECK(mapped.readline() == "last line");
+    CHECK_FALSE(mapped.eof());
+
+    // reading past the end gives an empty line and sets eofbit, like the
+    // generic line extraction does
+    CHECK(mapped.readline() == "");
+    CHECK(mapped.eof());
+
+    // the stream is no longer good, so the next read fails
+    CHECK_THROWS_AS(mapped.readline(), FileError);
+
+    mapped.rewind();
+    CHECK_FALSE(mapped.eof());
+    CHECK(mapped.readline() == "first");
+}
+
+TEST_CASE("Fallback to buffered reads") {
+    // Read-only plain text files open as memory-mapped files
+    auto tmpfile = NamedTempPath(".dat");
+    std::ofstream file(tmpfile, std::ios_base::binary);
+    file << "content\n";
+    file.close();
+
+    auto mapped = TextFile::open(tmpfile, File::READ, File::DEFAULT);
+    CHECK(dynamic_cast<MemoryMappedFile*>(mapped.get()) != nullptr);
+    CHECK(mapped->readline() == "content");
+
+    // Files that can not be mapped (here an empty file) fall back to the
+    // standard buffered implementation
+    auto empty = NamedTempPath(".dat");
+    std::ofstream(empty, std::ios_base::binary).close();
+
+    auto fallback = TextFile::open(empty, File::READ, File::DEFAULT);
+    CHECK(dynamic_cast<MemoryMappedFile*>(fallback.get()) == nullptr);
+    CHECK(dynamic_cast<PlainFile*>(fallback.get()) != nullptr);
+}